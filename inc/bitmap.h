@@ -8,14 +8,63 @@
 #include <errno.h>
 
 
+/*
+ * Word-level bitmaps: bit i lives in word i / 64 at position i % 64. On a
+ * little-endian host this is byte for byte the LSB-first layout of the
+ * result files, so a word buffer can be written out or read back as is.
+ * Bits past the logical length must stay clear; every operation below
+ * relies on it instead of masking the tail word.
+ */
+#define BITMAP_WORD_BITS    64
+#define BITMAP_WORDS(bits)  (((size_t)(bits) + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS)
+
+static inline void bitmap_set(uint64_t *map, size_t bit)
+{
+    map[bit / BITMAP_WORD_BITS] |= 1ULL << (bit % BITMAP_WORD_BITS);
+}
+
+// For maps shared between threads
+static inline void bitmap_set_atomic(uint64_t *map, size_t bit)
+{
+    __atomic_fetch_or(&map[bit / BITMAP_WORD_BITS], 1ULL << (bit % BITMAP_WORD_BITS),
+                      __ATOMIC_RELAXED);
+}
+
+static inline int bitmap_test(const uint64_t *map, size_t bit)
+{
+    return (map[bit / BITMAP_WORD_BITS] >> (bit % BITMAP_WORD_BITS)) & 1;
+}
+
+// dst may alias a or b; NEON when available, scalar otherwise
+void     bitmap_or(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t words);
+void     bitmap_and(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t words);
+void     bitmap_xor(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t words);
+void     bitmap_andnot(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t words);  // a & ~b
+
+uint64_t bitmap_popcount(const uint64_t *map, size_t words);
+int      bitmap_any(const uint64_t *map, size_t words);
+
+// Index of the first set (clear) bit at or after from, or bits if none
+size_t   bitmap_next_set(const uint64_t *map, size_t bits, size_t from);
+size_t   bitmap_next_clear(const uint64_t *map, size_t bits, size_t from);
+
+// ORs n bits of src starting at src_off into dst starting at dst_off
+void     bitmap_or_bits(uint64_t *dst, size_t dst_off, const uint64_t *src, size_t src_off, size_t n);
+void     bitmap_set_bits(uint64_t *map, size_t from, size_t n);
+
+#define bitmap_for_each_set(bit, map, bits)                                 \
+    for ((bit) = bitmap_next_set((map), (bits), 0);                         \
+         (bit) < (bits);                                                    \
+         (bit) = bitmap_next_set((map), (bits), (bit) + 1))
+
 typedef struct {
     uint32_t start;
     uint32_t end;
     uint32_t bits;
-    uint32_t size;
+    uint32_t size;                         // bytes written per bitmap
 
-    uint8_t *exec_bitmap;
-    uint8_t *timeout_bitmap;
+    uint64_t *exec_bitmap;                 // BITMAP_WORDS(bits) words
+    uint64_t *timeout_bitmap;
 } RangeBitmap;
 
 int range_bitmap_init(RangeBitmap *rb, uint32_t start, uint32_t end);
@@ -23,4 +72,28 @@ void range_bitmap_mark_exec(RangeBitmap *rb, uint32_t insn);
 void range_bitmap_mark_timeout(RangeBitmap *rb, uint32_t insn);
 int range_bitmap_has_timeout(const RangeBitmap *rb);
 int range_bitmap_flush(const RangeBitmap *rb, FILE *exec_file, FILE *timeout_file);
-void range_bitmap_destroy(RangeBitmap *rb);
\ No newline at end of file
+void range_bitmap_destroy(RangeBitmap *rb);
+
+/*
+ * A complete/timeout result file read back into memory, for tools and
+ * for rescreening against a previous run. Ranges are disjoint and kept
+ * sorted by start.
+ */
+typedef struct {
+    uint32_t  start;
+    uint32_t  end;
+    uint64_t *map;                         // BITMAP_WORDS(end - start) words
+} BitmapRange;
+
+typedef struct {
+    int          file_number;
+    int          count;
+    BitmapRange *ranges;
+} BitmapFile;
+
+int  bitmap_file_load(BitmapFile *bf, const char *path);
+void bitmap_file_free(BitmapFile *bf);
+// ORs the file's bits for [start, end) into dst (bit 0 is start); covered,
+// if not NULL, gets a bit for every encoding some range of the file spans
+void bitmap_file_extract(const BitmapFile *bf, uint32_t start, uint32_t end,
+                         uint64_t *dst, uint64_t *covered);
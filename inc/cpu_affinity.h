@@ -3,5 +3,53 @@
 #include <sched.h>
 #include <sys/mman.h>
 #include <stdio.h>
+#include <stdint.h>
 
-int set_cpu_affinity(pid_t pid, int core_id);
\ No newline at end of file
+// Low-jitter mode: SCHED_FIFO below the kernel's irq threads (50)
+#define LOWJITTER_RT_PRIORITY   10
+// RLIMIT_RTTIME, CPU time a FIFO thread may burn without blocking
+#define LOWJITTER_RTTIME_SOFT_US 500000
+#define LOWJITTER_RTTIME_HARD_US 1000000
+
+#define JITTER_PROBE_MS         100
+#define JITTER_GAP_NS           10000      // gaps above 10 us are counted
+
+int set_cpu_affinity(pid_t pid, int core_id);
+
+/*
+ * Cores set aside by isolcpus= or nohz_full=, read from
+ * /sys/devices/system/cpu/{isolated,nohz_full}. Returns how many.
+ */
+int cpu_isolated_set(cpu_set_t *set);
+/*
+ * index-th core for a low-jitter thread: isolated cores in the inherited
+ * affinity first, then the remaining allowed cores. -1 on error.
+ */
+int cpu_pick_low_jitter(int index);
+// SCHED_FIFO for the calling thread, RLIMIT_RTTIME for the process
+int set_realtime_fifo(int priority);
+
+/*
+ * Back-to-back CLOCK_MONOTONIC reads on the calling thread. Every gap
+ * between two reads is time the core was taken away (interrupt, tick,
+ * preemption), which a candidate would have spent under the watchdog.
+ */
+typedef struct {
+    uint64_t samples;
+    uint64_t max_gap_ns;
+    uint64_t gaps_over;                    // gaps above JITTER_GAP_NS
+    uint64_t gaps_over_limit;              // gaps above limit_ns
+    double   duration_s;
+} JitterReport;
+
+void jitter_probe(JitterReport *r, uint32_t duration_ms, uint64_t limit_ns);
+
+/*
+ * Main ID register of a core, from
+ * /sys/devices/system/cpu/cpuN/regs/identification/midr_el1 or else the
+ * "CPU implementer/variant/part/revision" lines of /proc/cpuinfo.
+ * 0 on success. Cores with equal MIDRs are the same microarchitecture.
+ */
+int cpu_midr(int cpu, uint32_t *midr);
+// Directory-safe name of a MIDR, "cortex-a53_r0p4" or "midr_410fd034"
+void midr_tag(uint32_t midr, char *buf, size_t len);
@@ -0,0 +1,44 @@
+#pragma once
+#include "core.h"
+
+/*
+ * Deprecated AArch32 instructions an ARMv8 kernel may emulate
+ * (CONFIG_ARMV8_DEPRECATED). /proc/sys/abi/<name> is 0 (undefined),
+ * 1 (trap and emulate) or 2 (hardware, only where the core still has it).
+ * An emulated encoding "executes" at the cost of a trap and is no hidden
+ * instruction, so the screener keeps it out of the exec bitmap.
+ */
+#define EMU_SWP            0x01            // SWP/SWPB
+#define EMU_SETEND         0x02
+#define EMU_CP15_BARRIER   0x04            // MCR p15 DSB/DMB/ISB
+
+#define EMU_ABI_EMULATE    1
+
+typedef struct {
+    int active;                            // EMU_* classes in mode 1
+} EmulationConfig;
+
+// Reads /proc/sys/abi, a missing file counts as not emulated
+void emulation_config_load(EmulationConfig *emu);
+// "swp setend" or "none", for the startup line
+const char *emulation_describe(const EmulationConfig *emu, char *buf, size_t len);
+// The active EMU_* class of insn (T32 in the hw1:hw2 form), 0 if none
+int  emulation_match(const EmulationConfig *emu, uint32_t insn, int thumb);
+
+/*
+ * Time spent inside the insn page for ordinary executed encodings, an
+ * exponential average taken once LATENCY_WARMUP samples are in. A
+ * kernel trap costs microseconds where the page takes well under one.
+ */
+#define LATENCY_WARMUP        256
+#define LATENCY_FACTOR        4
+#define LATENCY_MIN_EXCESS_NS 500
+#define LATENCY_RETRIES       3            // an outlier must repeat this often
+
+typedef struct {
+    double   base_ns;
+    uint32_t samples;
+} LatencyBaseline;
+
+// Whether exec_ns is an outlier; ordinary samples update the baseline
+int  latency_is_outlier(LatencyBaseline *lb, uint32_t exec_ns);
@@ -0,0 +1,20 @@
+#pragma once
+#include "core.h"
+
+#define ENCODING_MAX_RANGE  (1u << 20)     // larger ranges are skipped with a warning
+
+/*
+ * Streams encodings out of a phase-2 input list. Accepted lines: bare
+ * hex ("0xe0800001" or "e0800001", trailing text ignored, so crash lists
+ * work as is), "[start, end]" ranges as in the range and decoded_ranges
+ * files (end exclusive), '#' comments.
+ */
+typedef struct {
+    FILE     *in;
+    uint64_t  next;
+    uint64_t  end;
+} EncodingReader;
+
+void encoding_reader_init(EncodingReader *r, FILE *in);
+// 1 with *insn set, 0 at end of input
+int  encoding_reader_next(EncodingReader *r, uint32_t *insn);
@@ -0,0 +1,61 @@
+#pragma once
+#include "core.h"
+#include "sandbox.h"
+
+#define FAULT_LOG_BUFFER 4096
+
+/*
+ * One non-SIGILL outcome. resN_faults.bin is [file_number][record_count]
+ * followed by record_count of these. For a watchdog timeout (SIGALRM)
+ * fault_addr is meaningless and pc_offset is where the candidate spun.
+ * With FAULT_FLAG_LANDED the candidate branched into the page's landing
+ * zone (a SIGILL/SIGTRAP that is logged, unlike plain SIGILL) and
+ * pc_offset is the branch target. FAULT_FLAG_STATE_LOST: the candidate
+ * fell through, then the boilerplate found its frame clobbered and the
+ * signal (logged whatever it is) came from the epilogue.
+ *
+ * An encoding that executed (signum 0) only gets a record when it looks
+ * kernel-emulated and is left out of the exec bitmap: FAULT_FLAG_EMULATED
+ * when it matches an emulation enabled in /proc/sys/abi (si_code is the
+ * EMU_* class), FAULT_FLAG_SLOW when it took a trap's worth of time on
+ * every try. fault_addr is then the fastest execution in ns, if timed.
+ */
+#define FAULT_FLAG_LANDED    0x01
+#define FAULT_FLAG_EMULATED  0x02
+#define FAULT_FLAG_SLOW      0x04
+#define FAULT_FLAG_STATE_LOST 0x08
+
+typedef struct __attribute__((packed)) {
+    uint32_t insn;
+    uint8_t  signum;
+    uint8_t  flags;                        // FAULT_FLAG_*
+    int16_t  si_code;
+    uint32_t fault_addr;                   // si_addr
+    int32_t  pc_offset;                    // faulting pc - insn_location
+} FaultRecord;
+
+// Shared side-table file, appended to by every thread's FaultLog
+typedef struct {
+    FILE           *file;
+    int             file_number;
+    uint32_t        record_count;
+    pthread_mutex_t lock;
+} FaultLogFile;
+
+// Per-thread buffer, so recording a fault never takes a lock or a syscall
+typedef struct {
+    FaultLogFile *out;
+    uint32_t      count;
+    FaultRecord   records[FAULT_LOG_BUFFER];
+} FaultLog;
+
+int  fault_log_open(FaultLogFile *lf, const char *path, int file_number);
+int  fault_log_close(FaultLogFile *lf);
+
+void fault_log_init(FaultLog *log, FaultLogFile *out);
+void fault_record_from_ctx(FaultRecord *rec, uint32_t insn, const SandboxContext *ctx);
+int  fault_log_append(FaultLog *log, const FaultRecord *rec);
+int  fault_log_flush(FaultLog *log);
+
+// Reads resN_faults.bin back, records sorted by insn (caller frees)
+int  fault_log_load(const char *path, FaultRecord **records_out, uint32_t *count_out);
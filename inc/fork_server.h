@@ -0,0 +1,44 @@
+#pragma once
+#include "core.h"
+#include "sandbox.h"
+#include "fault_log.h"
+
+#define FORK_DEFAULT_BATCH      4096
+#define FORK_OUTCOME_SKIPPED    0xfe
+#define FORK_OUTCOME_PENDING    0xff
+
+// Parent-side limit for a batch, on top of the per-candidate watchdog
+#define FORK_BATCH_BASE_US      1000000
+#define FORK_BATCH_PER_INSN_US  1000
+
+// Runs one candidate in the child, returns -1 if it was not executed
+typedef int  (*fork_exec_t)(SandboxContext *ctx, uint32_t insn, void *arg);
+// Receives each outcome in the parent (signum 0 for exec)
+typedef void (*fork_record_t)(const FaultRecord *rec, void *arg);
+
+/*
+ * The parent keeps an initialised sandbox context and never executes a
+ * candidate itself. Each batch runs in a forked child that writes one
+ * outcome record per candidate into shared memory. When a child dies, the
+ * batch is bisected in fresh children until the culprit encoding is
+ * isolated; culprits are appended to crash_file.
+ */
+typedef struct {
+    SandboxContext *ctx;
+    uint32_t        batch_size;
+    FaultRecord    *outcomes;              // MAP_SHARED, batch_size records
+
+    fork_exec_t     exec_fn;
+    fork_record_t   record_fn;
+    void           *arg;
+
+    FILE           *crash_file;
+    uint64_t        forks;
+    uint64_t        crashes;
+} ForkServer;
+
+int  fork_server_init(ForkServer *fs, SandboxContext *ctx, uint32_t batch_size,
+                      fork_exec_t exec_fn, fork_record_t record_fn, void *arg,
+                      FILE *crash_file);
+int  fork_server_screen(ForkServer *fs, uint32_t start, uint32_t end);
+void fork_server_destroy(ForkServer *fs);
@@ -0,0 +1,53 @@
+#pragma once
+#include "core.h"
+#include "bitmap.h"
+
+/*
+ * One file-backed result bitmap for the whole 2^32 encoding space,
+ * shared by every worker. Layout: a one-page header, then one plane of
+ * 2^32 bits (512 MiB) per outcome. The file is sparse, so only pages
+ * covering screened ranges are ever allocated on disk.
+ *
+ * A 32-bit process cannot map a 1 GiB file, so workers map a window per
+ * range job, page aligned around [start, end), and mark outcomes with an
+ * atomic OR; two jobs only ever share the words at their edges. Readers
+ * can mmap the planes and test bits in place.
+ */
+#define GLOBAL_MAP_MAGIC        "HIDMAP01"
+#define GLOBAL_MAP_HEADER_BYTES 4096
+#define GLOBAL_MAP_PLANE_BYTES  (1ull << 29)
+
+enum {
+    GLOBAL_PLANE_EXEC,
+    GLOBAL_PLANE_TIMEOUT,
+    GLOBAL_PLANES,
+};
+
+typedef struct {
+    char     magic[8];
+    uint32_t header_bytes;
+    uint32_t planes;
+    uint64_t plane_bytes;
+} GlobalMapHeader;
+
+typedef struct {
+    int fd;
+} GlobalMap;
+
+typedef struct {
+    uint64_t *plane[GLOBAL_PLANES];        // word 0 holds bit first_bit
+    uint64_t  first_bit;
+    size_t    len;                         // bytes mapped per plane
+} GlobalMapWindow;
+
+// Creates and sizes the file if needed, checks the header otherwise
+int  global_map_open(GlobalMap *gm, const char *path);
+void global_map_close(GlobalMap *gm);
+
+int  global_map_window_open(GlobalMapWindow *w, const GlobalMap *gm, uint32_t start, uint32_t end);
+void global_map_window_close(GlobalMapWindow *w);
+
+static inline void global_map_mark(GlobalMapWindow *w, int plane, uint32_t insn)
+{
+    bitmap_set_atomic(w->plane[plane], (size_t)(insn - w->first_bit));
+}
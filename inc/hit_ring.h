@@ -0,0 +1,58 @@
+#pragma once
+#include "core.h"
+#include "fault_log.h"
+
+/*
+ * Single-producer/single-consumer ring of phase-1 hits in a shared file
+ * (put it on /dev/shm), so phase 2 can look at a hit while phase 1 is
+ * still screening. One screening thread pushes, one consumer process
+ * pops; each side only ever writes its own index, published with
+ * release/acquire, and the two indices sit on separate cache lines.
+ *
+ * A full ring holds the producer back while a consumer is attached and
+ * keeps moving. If the tail is stuck for HIT_RING_STALL_MS, or nobody is
+ * attached, hits are dropped and counted instead of stalling screening.
+ */
+#define HIT_RING_MAGIC          "HITRING1"
+#define HIT_RING_SLOTS_DEFAULT  (1u << 16)
+#define HIT_RING_STALL_MS       5000
+#define HIT_RING_WAIT_NS        50000      // producer/consumer back-off
+
+typedef struct {
+    char     magic[8];
+    uint32_t slots;                        // power of two
+    uint32_t thumb;                        // hits are T32 hw1:hw2
+    int32_t  file_number;
+
+    // Producer side
+    uint32_t head __attribute__((aligned(64)));
+    uint32_t producer_done;
+    uint64_t dropped;
+
+    // Consumer side
+    uint32_t tail __attribute__((aligned(64)));
+    uint32_t consumer_attached;
+} HitRingHeader;
+
+typedef struct {
+    HitRingHeader *hdr;
+    FaultRecord   *slots;
+    size_t         map_bytes;
+    int            consumer;               // this end pops
+
+    // Producer: dropping until the tail moves past stalled_tail
+    int            stalled;
+    uint32_t       stalled_tail;
+} HitRing;
+
+// Producer: replace the ring file with a fresh one (unlinked, never truncated)
+int  hit_ring_create(HitRing *r, const char *path, uint32_t slots, int thumb, int file_number);
+// Consumer: attach to an existing ring, waiting up to wait_ms for it to appear
+int  hit_ring_attach(HitRing *r, const char *path, uint32_t wait_ms);
+// Producer: no more hits; consumer: detach. Unmaps either way
+void hit_ring_close(HitRing *r);
+
+// 0 pushed, 1 dropped
+int  hit_ring_push(HitRing *r, const FaultRecord *rec);
+// 1 popped, 0 empty for now, -1 empty and the producer is done
+int  hit_ring_pop(HitRing *r, FaultRecord *rec);
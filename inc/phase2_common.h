@@ -0,0 +1,43 @@
+#pragma once
+#include "core.h"
+#include "sandbox.h"
+#include "register_states.h"
+#include "pmu_counter.h"
+
+/*
+ * Setup shared by the phase-2 tools (macro_valid, cluster_behavior,
+ * state_diff, characterize, hit_consumer): the signals a candidate can
+ * raise, the seccomp filter, outcome names and the NOP calibration each
+ * of them starts with.
+ */
+
+#define PHASE2_NOP_A32        0xe320f000
+#define PHASE2_BASELINE_RUNS  8
+#define PHASE2_GPRS           13          // r0-r12
+
+extern const char *const phase2_reg_names[PHASE2_GPRS];
+
+// Handlers for every signal a candidate can raise, plus the watchdog's
+void phase2_init_signal_handlers(void);
+// sandbox_ctx_init_template() with the seccomp filter; a missing filter only warns
+int  phase2_ctx_init(SandboxContext *ctx, const SandboxTemplate *tpl);
+
+// "exec", "sigill", ..., "timeout"; "signal" for anything else
+const char *phase2_outcome_name(int signum);
+
+// One A32 candidate in the regs_template page, states[2] zeroed first
+void phase2_run_reg(SandboxContext *ctx, RegisterStates *states, uint32_t insn);
+void phase2_run_pmu(SandboxContext *ctx, RegisterStates *states, PmuCounter *pmu,
+                    PmuResult *result, uint32_t insn);
+// Same in the regs_ext_template page
+void phase2_run_ext(SandboxContext *ctx, ExtRegisterStates *states, uint32_t insn);
+
+/*
+ * Runs the NOP and stores the PC distance between the two snapshots of a
+ * candidate that falls through. With pmu, baseline gets the template's
+ * own loads and stores, smallest of PHASE2_BASELINE_RUNS. -1 if the NOP
+ * raised a signal.
+ */
+int  phase2_calibrate(SandboxContext *ctx, PmuCounter *pmu, PmuResult *baseline,
+                      uint32_t *pc_delta);
+int  phase2_calibrate_ext(SandboxContext *ctx, uint32_t *pc_delta);
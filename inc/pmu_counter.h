@@ -19,8 +19,35 @@ typedef struct {
     uint64_t st_count;
 } PmuResult;
 
+/*
+ * Cycles and instructions retired (user space only) as one perf group,
+ * so both cover exactly the same window.
+ */
+typedef struct {
+    int cycles_fd;                         // group leader
+    int insns_fd;
+} PmuGroup;
+
+typedef struct {
+    uint64_t cycles;
+    uint64_t insns;
+    uint64_t ns;                           // wall time, includes kernel emulation
+} PmuGroupResult;
+
 int perf_event_open(struct perf_event_attr *hw_event, pid_t pid, int cpu, int group_fd, unsigned long flags);
 int init_memory_monitor(PmuCounter *pmu);
 void pre_pmu(void *ctx);
 void post_pmu(void *ctx);
-void execute_insn_page_pmu(uint8_t *insn_bytes, size_t insn_length, RegisterStates *states, PmuCounter *pmu, PmuResult *result);
\ No newline at end of file
+void execute_insn_page_pmu(uint8_t *insn_bytes, size_t insn_length, RegisterStates *states, PmuCounter *pmu, PmuResult *result);
+
+// Context-based variant (sandbox.h and this header include each other);
+// the counters are stopped even if the candidate faults
+struct SandboxContext;
+void sandbox_ctx_execute_pmu(struct SandboxContext *sctx, uint8_t *insn_bytes, size_t insn_length,
+                             RegisterStates *states, PmuCounter *pmu, PmuResult *result);
+
+int  pmu_group_open(PmuGroup *g);
+void pmu_group_close(PmuGroup *g);
+// Runs the page with no argument; result is left zeroed if the candidate faults
+void sandbox_ctx_execute_group(struct SandboxContext *sctx, uint8_t *insn_bytes, size_t insn_length,
+                               PmuGroup *g, PmuGroupResult *result);
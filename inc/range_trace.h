@@ -0,0 +1,86 @@
+#pragma once
+#include "core.h"
+
+#define RANGE_TRACE_BUFFER  256
+
+// Outcome counters of a traced range, by the signal the candidate raised
+enum {
+    TRACE_EXEC,                            // no signal, emulated or not
+    TRACE_SIGILL,
+    TRACE_SIGSEGV,
+    TRACE_SIGBUS,
+    TRACE_SIGTRAP,
+    TRACE_SIGSYS,
+    TRACE_TIMEOUT,                         // SIGALRM/SIGPROF watchdog
+    TRACE_OTHER,
+    RANGE_TRACE_OUTCOMES
+};
+
+// How much of a thread's time cycles covers (perf_event_paranoid decides)
+#define TRACE_CYCLES_NONE    0
+#define TRACE_CYCLES_USER    1
+#define TRACE_CYCLES_KERNEL  2             // user and kernel: signal delivery included
+
+/*
+ * One screened range (worker -t). resN_trace.bin is
+ * [file_number][record_count][cycles_scope] followed by record_count of
+ * these, in the order threads flushed them. Times are CLOCK_MONOTONIC,
+ * cycles are the screening thread's own.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t start;                        // [start, end)
+    uint32_t end;
+    uint64_t begin_ns;
+    uint64_t wall_ns;
+    uint64_t cycles;                       // 0 with TRACE_CYCLES_NONE
+    uint16_t thread;
+    int16_t  core;                         // where the range finished
+    uint32_t outcomes[RANGE_TRACE_OUTCOMES];
+} RangeTraceRecord;
+
+// Shared trace file, appended to by every thread's RangeTrace
+typedef struct {
+    FILE           *file;
+    int             file_number;
+    uint32_t        record_count;
+    uint32_t        cycles_scope;          // narrowest scope any thread got
+    pthread_mutex_t lock;
+} RangeTraceFile;
+
+// Per-thread buffer and cycle counter, like FaultLog
+typedef struct {
+    RangeTraceFile  *out;
+    int              cycles_fd;            // -1: no counter
+    uint64_t         cycles_begin;
+    RangeTraceRecord cur;
+    uint32_t         count;
+    RangeTraceRecord records[RANGE_TRACE_BUFFER];
+} RangeTrace;
+
+int  range_trace_open(RangeTraceFile *tf, const char *path, int file_number);
+int  range_trace_close(RangeTraceFile *tf);
+
+void range_trace_init(RangeTrace *t, RangeTraceFile *out, int thread);
+void range_trace_destroy(RangeTrace *t);
+
+void range_trace_begin(RangeTrace *t, uint32_t start, uint32_t end);
+int  range_trace_end(RangeTrace *t);
+int  range_trace_flush(RangeTrace *t);
+
+static inline void range_trace_count(RangeTrace *t, int signum)
+{
+    int slot;
+
+    switch (signum) {
+    case 0:       slot = TRACE_EXEC;    break;
+    case SIGILL:  slot = TRACE_SIGILL;  break;
+    case SIGSEGV: slot = TRACE_SIGSEGV; break;
+    case SIGBUS:  slot = TRACE_SIGBUS;  break;
+    case SIGTRAP: slot = TRACE_SIGTRAP; break;
+    case SIGSYS:  slot = TRACE_SIGSYS;  break;
+    case SIGALRM:
+    case SIGPROF: slot = TRACE_TIMEOUT; break;
+    default:      slot = TRACE_OTHER;   break;
+    }
+    t->cur.outcomes[slot]++;
+}
@@ -8,4 +8,18 @@ typedef struct __attribute__((aligned(4))) {
     uint32_t cpsr;
 } RegisterStates;
 
-extern RegisterStates *reg_state_base_slot;
\ No newline at end of file
+extern RegisterStates *reg_state_base_slot;
+
+/*
+ * Everything EL0 can observe, captured by regs_ext_template.S in one
+ * run. The assembly uses fixed offsets: core 0, fpscr 68, tpidrurw 72,
+ * tpidruro 76, d 80; 336 bytes per snapshot. The APSR GE bits are
+ * cpsr[19:16].
+ */
+typedef struct __attribute__((aligned(8))) {
+    RegisterStates core;
+    uint32_t fpscr;
+    uint32_t tpidrurw;                     // user read/write thread id
+    uint32_t tpidruro;                     // user read-only thread id (TLS)
+    uint64_t d[32];
+} ExtRegisterStates;
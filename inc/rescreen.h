@@ -0,0 +1,59 @@
+#pragma once
+#include "core.h"
+#include "bitmap.h"
+#include "fault_log.h"
+
+/*
+ * Incremental rescreening against a previous result set of the same file.
+ *
+ * An encoding is re-executed when the previous run had no range for it,
+ * when it executed or timed out, when it died of anything but SIGILL or
+ * an ordinary SIGSEGV/SIGBUS, when a stability pass found it flaky or
+ * when a changed-ranges file names it.
+ * Everything else is stable: skipped, or re-executed 1 in sample_every
+ * as a drift check. Skipped crashes keep their previous fault record.
+ */
+typedef struct {
+    uint32_t start;
+    uint32_t end;                          // exclusive
+} RescreenRange;
+
+typedef struct {
+    BitmapFile     exec;
+    BitmapFile     timeout;
+
+    FaultRecord   *faults;                 // sorted by insn
+    uint32_t       fault_count;
+    int            has_faults;             // 0: crashes look like SIGILL
+
+    uint32_t      *unstable;               // flagged by resN_stability.bin, sorted
+    uint32_t       unstable_count;
+
+    RescreenRange *changed;                // sorted by start
+    size_t         changed_count;
+
+    uint32_t       sample_every;           // 0: never re-execute stable encodings
+} PrevResults;
+
+// Work for one range [start, end); bit i stands for start + i
+typedef struct {
+    uint32_t           start;
+    uint32_t           bits;
+    uint64_t          *rerun;              // everything to execute, samples included
+    uint64_t          *sampled;            // stable encodings picked as samples
+
+    const FaultRecord *faults;             // previous records inside the range
+    uint32_t           fault_count;
+} RescreenPlan;
+
+int  prev_results_load(PrevResults *pr, const char *dir, int file_number);
+int  prev_results_load_changed(PrevResults *pr, const char *path);
+void prev_results_free(PrevResults *pr);
+
+int  rescreen_plan_init(RescreenPlan *plan, const PrevResults *pr,
+                        uint32_t start, uint32_t end, unsigned int *seed);
+void rescreen_plan_destroy(RescreenPlan *plan);
+
+// Whether a sampled encoding's new outcome contradicts the previous run
+int  rescreen_outcome_changed(const RescreenPlan *plan, const PrevResults *pr,
+                              uint32_t insn, int signum);
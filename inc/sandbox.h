@@ -7,33 +7,168 @@
 #define MY_SIGSTKSZ 8192
 #define SA_NONE     0
 
+#define WATCHDOG_US 200
+
+#define T32_NOP     0xbf00                 // 16-bit Thumb nop
+
+/*
+ * Landing zone: every page word after the boilerplate is an undefined
+ * encoding carrying its own offset, so a candidate that branches inside
+ * the page traps at once instead of sliding into the guard page or
+ * spinning until the watchdog. A32 words are UDF #(word index), T32
+ * halfwords UDF #(halfword index & 0xff). A few immediates are the
+ * kernel's breakpoints and raise SIGTRAP instead of SIGILL.
+ */
+#define A32_UDF(imm16)  (0xe7f000f0u | (((imm16) & 0xfff0u) << 4) | ((imm16) & 0xfu))
+#define T32_UDF(imm8)   (0xde00u | ((imm8) & 0xffu))
+
+/*
+ * The screening boilerplates keep their frame pointer in TPIDRURW with
+ * this canary next to it, and trap with SCREEN_LOST_TRAP (T32: its low
+ * byte) when the check fails on the way back.
+ */
+#define SCREEN_CANARY     0x7a11c0deu
+#define SCREEN_LOST_TRAP  0xc0a5
+
+// Low-jitter contexts nap this long after every slice of screening
+#define LOWJITTER_CHECK_EVERY   1024       // candidates between clock reads
+#define LOWJITTER_SLICE_NS      100000000ull
+#define LOWJITTER_NAP_NS        50000
+
+/*
+ * Boilerplate copied into a context's insn page. The candidate is
+ * patched in at `location`, which must be word aligned.
+ */
+typedef struct {
+    char *start;
+    char *end;
+    char *location;
+    int   thumb;                           // entered in Thumb state
+} SandboxTemplate;
+
+/*
+ * Everything one screening loop needs. A context belongs to the thread
+ * that called sandbox_ctx_init(): its watchdog is a SIGEV_THREAD_ID timer
+ * aimed at that thread and its sigaltstack is installed for that thread,
+ * so one process can run one screening thread per core.
+ */
+typedef struct SandboxContext {
+    void *insn_region;                     // [guard][code][guard]
+    void *insn_page;                       // Executable Page
+    uint32_t insn_offset;
+    int      thumb;
+    uint32_t fill_start;                   // first trap-filled byte of the page
+
+    volatile sig_atomic_t last_insn_signum;
+    volatile sig_atomic_t executing_insn;
+    volatile sig_atomic_t timeout_occurred;
+
+    // siginfo/ucontext of the last signal, valid when last_insn_signum != 0
+    int      fault_code;
+    uint32_t fault_addr;
+    uint32_t fault_pc;
+    // The trap came from the landing zone, fault_pc is the branch target
+    volatile sig_atomic_t landed;
+    // The candidate ran, then the boilerplate could not recover its frame
+    volatile sig_atomic_t state_lost;
+    uint32_t tpidrurw;                     // the caller's, put back after a signal
+
+    sigjmp_buf escape_env;
+
+    timer_t  watchdog_timer;
+    int      has_timer;
+    uint32_t watchdog_us;                  // 0: WATCHDOG_US, below 1 s
+
+    // With time_exec set, ns spent in the page when it returned normally
+    int      time_exec;
+    uint32_t exec_ns;
+
+    uint8_t *sig_stack_mem;
+    stack_t  sig_stack;
+
+    // Set by sandbox_ctx_low_jitter()
+    int      low_jitter;
+    uint32_t lj_execs;
+    uint64_t lj_last_nap_ns;
+} SandboxContext;
+
+/*
+ * Legacy single-threaded API. These mirror the default context, which is
+ * driven by init_insn_page()/init_watchdog_timer()/execute_insn_page*().
+ */
 extern void *insn_region;                  // [guard][code][guard]
 extern void *insn_page;                    // Executable Page
 extern volatile sig_atomic_t last_insn_signum;
-extern volatile sig_atomic_t executing_insn;
 extern volatile sig_atomic_t timeout_occurred;
 extern uint32_t insn_offset;
 extern uint32_t mask;
 
 extern char boilerplate_start, boilerplate_end, insn_location;
 
-extern sigjmp_buf escape_env;
 extern timer_t watchdog_timer;
 
 extern uint8_t sig_stack_array[MY_SIGSTKSZ];
 extern stack_t sig_stack;
 
+extern SandboxContext sandbox_default_ctx;
+
+#ifdef SANDBOX_STATS
+// Kernel entries made by the sandbox itself, only compiled into bench builds
+typedef struct {
+    uint64_t mprotect_calls;
+    uint64_t timer_calls;
+    uint64_t sigmask_calls;    // sigsetjmp/siglongjmp with savemask
+    uint64_t cache_flushes;
+    uint64_t signals;
+} SandboxStats;
+
+extern SandboxStats sandbox_stats;
+#define SANDBOX_STAT_INC(field) (sandbox_stats.field++)
+#else
+#define SANDBOX_STAT_INC(field) ((void)0)
+#endif
+
 typedef void (*exec_t)(void *addr, void *ctx);
 typedef void (*converge_exec_t)(void *ctx);
 
 void signal_handler(int, siginfo_t *, void*);
 void init_signal_handler(void(*handler)(int, siginfo_t*, void*), int, int);
 
+int  sandbox_ctx_init(SandboxContext *ctx);
+int  sandbox_ctx_init_template(SandboxContext *ctx, const SandboxTemplate *tpl);
+void sandbox_ctx_destroy(SandboxContext *ctx);
+int  sandbox_ctx_after_fork(SandboxContext *ctx);
+/*
+ * Prefault and mlock the insn page and the signal stack, so no candidate
+ * takes a page fault on the way in or out, and make the context nap
+ * between screening slices (a SCHED_FIFO thread never blocks otherwise
+ * and would run into RLIMIT_RTTIME).
+ */
+int  sandbox_ctx_low_jitter(SandboxContext *ctx);
+/*
+ * Seccomp filter for the calling thread: a system call made from the
+ * context's insn page is not run but raises SIGSYS, recorded with the
+ * syscall number in fault_addr. Calls from anywhere else (the sandbox's
+ * own mprotect, timer_settime, sigreturn) are allowed. Install it on the
+ * thread that owns ctx, once.
+ */
+int  sandbox_ctx_seccomp(SandboxContext *ctx);
+void sandbox_ctx_execute(SandboxContext *ctx, uint8_t *insn_bytes, size_t insn_length, void *cb_ctx, converge_exec_t pre_exec, exec_t exec_cb, converge_exec_t post_exec);
+void sandbox_ctx_execute_screen(SandboxContext *ctx, uint8_t *insn_bytes, size_t insn_length);
+// The page is entered with states in r0, for the regs_template boilerplate
+void sandbox_ctx_execute_reg(SandboxContext *ctx, uint8_t *insn_bytes, size_t insn_length,
+                             RegisterStates *states);
+// Same, for the regs_ext_template boilerplate (states[2])
+void sandbox_ctx_execute_ext(SandboxContext *ctx, uint8_t *insn_bytes, size_t insn_length,
+                             ExtRegisterStates *states);
+
 int init_insn_page(void);
 void execute_insn_page(uint8_t *insn_bytes, size_t insn_length, void *ctx, converge_exec_t pre_exec, exec_t exec_cb, converge_exec_t post_exec);
 void execute_insn_page_screen(uint8_t *insn_bytes, size_t insn_length);
 void execute_insn_page_reg(uint8_t *insn_bytes, size_t insn_length, RegisterStates *states);
 size_t fill_insn_buffer(uint8_t*, size_t, uint32_t);
+int    t32_is_32bit(uint16_t hw1);
+size_t fill_t32_insn_buffer(uint8_t*, size_t, uint32_t);
 
 int init_watchdog_timer(void);
 void arm_watchdog_us(int us);
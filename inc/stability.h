@@ -0,0 +1,58 @@
+#pragma once
+#include "core.h"
+#include "bitmap.h"
+#include "fault_log.h"
+#include "rescreen.h"
+
+/*
+ * Stability post-pass (worker -s) over a finished result set.
+ *
+ * Outcomes rarely depend on the register fields Rm (bits 0-3), Rd/Rs
+ * (8-11), Rd/Rt (12-15) and Rn (16-19); these are the same bit positions
+ * for A32 and for a 32-bit T32 hw1:hw2. An encoding is outvoted in a
+ * field when a clear majority of the field's other 15 values produced
+ * another outcome. Rn = PC and the like are outvoted in their own field
+ * only; an encoding outvoted in two or more fields stands alone in the
+ * encoding space and is a suspect. Re-executed a few times, it turns out
+ * flaky, stable, or changed. Every field lies below bit 20, so each
+ * aligned 2^20 block is scanned on its own.
+ *
+ * resN_stability.bin is [file_number][record_count][runs] followed by
+ * record_count of these, sorted by insn; encodings without a record were
+ * never suspects. Rescreening (-p) re-executes every STABILITY_FLAKY
+ * or STABILITY_CHANGED one again.
+ */
+#define STABILITY_BLOCK_SHIFT    20
+#define STABILITY_BLOCK          (1u << STABILITY_BLOCK_SHIFT)
+#define STABILITY_DEFAULT_RUNS   5
+#define STABILITY_MIN_NEIGHBORS  3         // agreeing neighbors that make a majority
+
+// Outcome classes; a signal other than SIGILL is STAB_CLASS_SIGNAL + signum
+#define STAB_CLASS_NONE          0         // not screened
+#define STAB_CLASS_SIGILL        1
+#define STAB_CLASS_EXEC          2
+#define STAB_CLASS_TIMEOUT       3
+#define STAB_CLASS_EMULATED      4
+#define STAB_CLASS_SIGNAL        16
+
+#define STABILITY_FLAKY          0x01      // the runs did not all agree
+#define STABILITY_CHANGED        0x02      // they agreed, but not with the screen
+
+typedef struct __attribute__((packed)) {
+    uint32_t insn;
+    uint8_t  recorded;                     // STAB_CLASS_* of the screen
+    uint8_t  flags;                        // STABILITY_*, 0: stable after all
+    uint8_t  agreed;                       // runs that matched recorded
+    uint8_t  other;                        // most frequent class that did not
+} StabilityRecord;
+
+// Outcome of every encoding in [base, base + STABILITY_BLOCK), from the result files
+void stability_classify_block(const PrevResults *pr, uint32_t base, int thumb, uint8_t *classes,
+                              uint64_t *exec_scratch, uint64_t *covered_scratch);
+// Sets bit i of suspects when base + i is outvoted in two fields; returns the count
+uint32_t stability_find_suspects(const uint8_t *classes, uint64_t *outvoted, uint64_t *suspects);
+
+int  stability_write(const char *path, int file_number, uint32_t runs,
+                     const StabilityRecord *records, uint32_t count);
+// Encodings flagged flaky or changed, sorted (caller frees)
+int  stability_load_unstable(const char *path, uint32_t **insns_out, uint32_t *count_out);
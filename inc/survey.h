@@ -0,0 +1,43 @@
+#pragma once
+#include "core.h"
+#include <math.h>
+
+/*
+ * Survey mode (worker/dispatcher -y): a fixed number of uniformly drawn
+ * encodings per stratum instead of every encoding, to see how many
+ * hidden instructions a new core has and where, before a full screen.
+ * A stratum is the part of one input file inside one top-bits bucket,
+ * or the whole file with 0 bucket bits. The draws only depend on the
+ * seed, the file and the bucket, not on the thread count.
+ *
+ * resN_survey.txt has one "[start, end] population sampled exec timeout"
+ * line per stratum, the remaining columns are derived from those.
+ * A hit is an encoding that executed (not kernel-emulated) or timed out.
+ */
+#define SURVEY_DEFAULT_SEED      1
+#define SURVEY_MAX_BUCKET_BITS   16
+#define SURVEY_Z                 1.96      // 95% intervals
+
+typedef struct {
+    int      file_number;
+    uint32_t start;                        // [start, end) spanned by the population
+    uint32_t end;
+    uint64_t population;                   // encodings of the file in the stratum
+    uint64_t sampled;
+    uint64_t exec;
+    uint64_t timeout;
+} SurveyStratum;
+
+// splitmix64, one stream per (seed, file, bucket)
+uint64_t survey_stream(uint64_t seed, int file_number, uint32_t bucket);
+uint64_t survey_next(uint64_t *state);
+
+// Wilson score interval of hits/n at SURVEY_Z; [0, 1] without samples
+void survey_wilson(uint64_t hits, uint64_t n, double *lo, double *hi);
+// Point estimate of the density, exact when the stratum was exhausted
+double survey_density(const SurveyStratum *s);
+
+int  survey_write(const char *path, int file_number, uint64_t seed, int bucket_bits,
+                  uint32_t per_stratum, const SurveyStratum *strata, int count);
+// Appends the strata of one resN_survey.txt to *strata (realloc'd)
+int  survey_read(const char *path, SurveyStratum **strata, int *count);
@@ -3,6 +3,7 @@ import struct
 from pathlib import Path
 import multiprocessing as mp
 import os
+import sys
 
 
 def bitmap_to_ranges(start, end, bitmap_bytes):
@@ -101,14 +102,19 @@ def _worker(args):
 
 
 def main():
-    bitmap_dir = Path("bitmap_results")
-    out_dir = Path("decoded_ranges")
+    # dispatcher -a 时每种核心一个子目录，如 bitmap_results/cortex-a53_r0p4
+    bitmap_dir = Path(sys.argv[1]) if len(sys.argv) > 1 else Path("bitmap_results")
+    out_dir = Path(sys.argv[2]) if len(sys.argv) > 2 else Path("decoded_ranges")
 
     if not bitmap_dir.is_dir():
         print(f"bitmap directory not found: {bitmap_dir}")
         return
 
-    bin_files = sorted(bitmap_dir.glob("res*_*.bin"))
+    # 只解析 complete / timeout 位图，resN_faults.bin 由 decode_faults.py 处理
+    bin_files = sorted(
+        p for p in bitmap_dir.glob("res*_*.bin")
+        if p.stem.endswith(("_complete", "_timeout"))
+    )
     if not bin_files:
         print(f"no *.bin files found in {bitmap_dir}")
         return
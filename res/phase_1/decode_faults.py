@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+import csv
+import signal
+import struct
+import sys
+from pathlib import Path
+
+# resN_faults.bin：header [file_number int32][record_count uint32]，
+# 之后是 record_count 条 FaultRecord（见 inc/fault_log.h）
+HEADER = struct.Struct("<iI")
+RECORD = struct.Struct("<IBBhIi")
+FAULT_FLAG_LANDED = 0x01
+FAULT_FLAG_EMULATED = 0x02
+FAULT_FLAG_SLOW = 0x04
+FAULT_FLAG_STATE_LOST = 0x08
+# FAULT_FLAG_EMULATED 时 si_code 是 EMU_* 类别（见 inc/emulation.h）
+EMU_CLASSES = ((0x01, "swp"), (0x02, "setend"), (0x04, "cp15_barrier"))
+
+
+def signal_name(signum):
+    if signum == 0:
+        return "exec"
+    try:
+        return signal.Signals(signum).name
+    except ValueError:
+        return f"SIG{signum}"
+
+
+def emulated_name(flags, si_code):
+    """内核模拟的执行：/proc/sys/abi 里的类别，或者只是每次都慢（slow）"""
+    names = []
+    if flags & FAULT_FLAG_EMULATED:
+        names += [name for bit, name in EMU_CLASSES if si_code & bit]
+    if flags & FAULT_FLAG_SLOW:
+        names.append("slow")
+    return "|".join(names)
+
+
+def read_faults(bin_path: Path):
+    """
+    读取一个 faults 文件，返回 (file_number, [(insn, signum, flags, si_code, fault_addr, pc_offset), ...])
+    """
+    with bin_path.open("rb") as f:
+        header = f.read(HEADER.size)
+        if len(header) != HEADER.size:
+            raise ValueError(f"{bin_path} header too short")
+
+        file_number, record_count = HEADER.unpack(header)
+
+        data = f.read(record_count * RECORD.size)
+        if len(data) != record_count * RECORD.size:
+            raise ValueError(
+                f"{bin_path} expected {record_count} records, "
+                f"got {len(data) // RECORD.size}"
+            )
+
+    records = []
+    for insn, signum, flags, si_code, fault_addr, pc_offset in RECORD.iter_unpack(data):
+        records.append((insn, signum, flags, si_code, fault_addr, pc_offset))
+
+    # 多线程写入时记录是按 flush 顺序排列的
+    records.sort()
+    return file_number, records
+
+
+def main():
+    bitmap_dir = Path(sys.argv[1]) if len(sys.argv) > 1 else Path("bitmap_results")
+    out_dir = Path("decoded_ranges")
+
+    fault_files = sorted(bitmap_dir.glob("res*_faults.bin"))
+    if not fault_files:
+        print(f"no res*_faults.bin files found in {bitmap_dir}")
+        return
+
+    out_dir.mkdir(parents=True, exist_ok=True)
+    total = 0
+
+    for bin_path in fault_files:
+        file_number, records = read_faults(bin_path)
+        out_path = out_dir / (bin_path.stem + "_decoded.csv")
+
+        with out_path.open("w", newline="", encoding="utf-8") as out:
+            writer = csv.writer(out)
+            writer.writerow(["insn", "signal", "landed", "state_lost", "emulated", "si_code", "fault_addr", "pc_offset"])
+            for insn, signum, flags, si_code, fault_addr, pc_offset in records:
+                # landed=1：分支落在陷阱区，pc_offset 就是分支目标
+                # state_lost=1：候选指令执行完了，但回来时栈帧（TPIDRURW/canary）被破坏
+                # SIGSYS：候选指令发起的系统调用被 seccomp 拦下，fault_addr 是调用号
+                # emulated 非空：执行了但走的是内核模拟，fault_addr 是最快一次的 ns
+                writer.writerow([
+                    f"0x{insn:08X}", signal_name(signum), flags & FAULT_FLAG_LANDED,
+                    int(bool(flags & FAULT_FLAG_STATE_LOST)),
+                    emulated_name(flags, si_code), si_code, f"0x{fault_addr:08X}", pc_offset,
+                ])
+
+        print(f"  {bin_path.name}: file_number={file_number}, {len(records)} records -> {out_path}")
+        total += len(records)
+
+    print(f"Total fault records: {total}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+import csv
+import signal
+import struct
+import sys
+from pathlib import Path
+
+# resN_stability.bin（worker -s）：header [file_number int32][record_count uint32][runs uint32]，
+# 之后是 record_count 条 StabilityRecord（见 inc/stability.h），按 insn 排序
+HEADER = struct.Struct("<iII")
+RECORD = struct.Struct("<IBBBB")
+STABILITY_FLAKY = 0x01
+STABILITY_CHANGED = 0x02
+CLASSES = {0: "none", 1: "SIGILL", 2: "exec", 3: "timeout", 4: "emulated"}
+STAB_CLASS_SIGNAL = 16
+
+
+def class_name(cls):
+    """STAB_CLASS_*；SIGILL 以外的信号是 STAB_CLASS_SIGNAL + signum"""
+    if cls < STAB_CLASS_SIGNAL:
+        return CLASSES.get(cls, f"class{cls}")
+    try:
+        return signal.Signals(cls - STAB_CLASS_SIGNAL).name
+    except ValueError:
+        return f"SIG{cls - STAB_CLASS_SIGNAL}"
+
+
+def verdict(flags):
+    if flags & STABILITY_FLAKY:
+        return "flaky"
+    if flags & STABILITY_CHANGED:
+        return "changed"
+    return "stable"
+
+
+def read_stability(bin_path: Path):
+    """读取一个 stability 文件，返回 (file_number, runs, [(insn, recorded, flags, agreed, other), ...])"""
+    with bin_path.open("rb") as f:
+        header = f.read(HEADER.size)
+        if len(header) != HEADER.size:
+            raise ValueError(f"{bin_path} header too short")
+
+        file_number, record_count, runs = HEADER.unpack(header)
+
+        data = f.read(record_count * RECORD.size)
+        if len(data) != record_count * RECORD.size:
+            raise ValueError(
+                f"{bin_path} expected {record_count} records, "
+                f"got {len(data) // RECORD.size}"
+            )
+
+    return file_number, runs, list(RECORD.iter_unpack(data))
+
+
+def main():
+    bitmap_dir = Path(sys.argv[1]) if len(sys.argv) > 1 else Path("bitmap_results")
+    out_dir = Path("decoded_ranges")
+
+    stability_files = sorted(bitmap_dir.glob("res*_stability.bin"))
+    if not stability_files:
+        print(f"no res*_stability.bin files found in {bitmap_dir}")
+        return
+
+    out_dir.mkdir(parents=True, exist_ok=True)
+    totals = {"stable": 0, "flaky": 0, "changed": 0}
+
+    for bin_path in stability_files:
+        file_number, runs, records = read_stability(bin_path)
+        out_path = out_dir / (bin_path.stem + "_decoded.csv")
+        counts = {"stable": 0, "flaky": 0, "changed": 0}
+
+        with out_path.open("w", newline="", encoding="utf-8") as out:
+            writer = csv.writer(out)
+            writer.writerow(["insn", "verdict", "recorded", "agreed", "runs", "other"])
+            for insn, recorded, flags, agreed, other in records:
+                # stable：重跑和筛选结果一致，和邻居不同是真的依赖操作数
+                # flaky：重跑之间不一致；changed：重跑一致，但和筛选结果不同
+                v = verdict(flags)
+                counts[v] += 1
+                writer.writerow([
+                    f"0x{insn:08X}", v, class_name(recorded), agreed, runs,
+                    class_name(other) if agreed < runs else "",
+                ])
+
+        print(f"  {bin_path.name}: file_number={file_number}, {len(records)} suspects, "
+              f"{counts['flaky']} flaky, {counts['changed']} changed -> {out_path}")
+        for k in totals:
+            totals[k] += counts[k]
+
+    print(f"Total: {totals['stable']} stable, {totals['flaky']} flaky, {totals['changed']} changed")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+import mmap
+import os
+import struct
+import sys
+from pathlib import Path
+
+# global map（worker -g）：一页 header，之后每种结果一个 2^32 bit 的 plane，
+# bit i 在 byte i/8 的第 i%8 位（LSB first），见 inc/global_map.h
+MAGIC = b"HIDMAP01"
+HEADER = struct.Struct("<8sIIQ")
+PLANES = ("exec", "timeout")
+
+
+class GlobalMap:
+    def __init__(self, path: Path):
+        self.fd = os.open(path, os.O_RDONLY)
+        magic, header_bytes, planes, plane_bytes = HEADER.unpack(os.pread(self.fd, HEADER.size, 0))
+        if magic != MAGIC or planes != len(PLANES):
+            raise ValueError(f"{path} is not a global result map")
+        self.header_bytes = header_bytes
+        self.plane_bytes = plane_bytes
+        # 只映射不读：没写过的页是文件空洞，不占内存也不占磁盘
+        self.map = mmap.mmap(self.fd, 0, prot=mmap.PROT_READ)
+
+    def test(self, plane, insn):
+        byte = self.map[self.header_bytes + plane * self.plane_bytes + insn // 8]
+        return (byte >> (insn % 8)) & 1
+
+    def extents(self, plane):
+        """plane 里真正分配过的 [lo, hi) 字节区间，用 SEEK_DATA/SEEK_HOLE 跳过空洞"""
+        base = self.header_bytes + plane * self.plane_bytes
+        end = base + self.plane_bytes
+        off = base
+        while off < end:
+            try:
+                data = os.lseek(self.fd, off, os.SEEK_DATA)
+            except OSError:
+                return
+            if data >= end:
+                return
+            hole = min(os.lseek(self.fd, data, os.SEEK_HOLE), end)
+            yield data - base, hole - base
+            off = hole
+
+    def ranges(self, plane):
+        """置 1 的编码，合并成 [start, end) 区间"""
+        base = self.header_bytes + plane * self.plane_bytes
+        cur_start = None
+        cur_end = None
+        for lo, hi in self.extents(plane):
+            view = memoryview(self.map)[base + lo:base + hi]
+            words = view.cast("Q")
+            for w, word in enumerate(words):
+                if not word:
+                    continue
+                first = (lo + w * 8) * 8
+                for bit in range(64):
+                    if not (word >> bit) & 1:
+                        continue
+                    insn = first + bit
+                    if cur_end == insn:
+                        cur_end += 1
+                    else:
+                        if cur_start is not None:
+                            yield cur_start, cur_end
+                        cur_start, cur_end = insn, insn + 1
+            view.release()
+        if cur_start is not None:
+            yield cur_start, cur_end
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(f"usage: {sys.argv[0]} <global_map> [insn ...]")
+        print("  with encodings: print their outcome")
+        print("  without: write decoded_ranges/global_<exec|timeout>_decoded.txt")
+        return 1
+
+    gm = GlobalMap(Path(sys.argv[1]))
+
+    if len(sys.argv) > 2:
+        for arg in sys.argv[2:]:
+            insn = int(arg, 16)
+            hit = [name for p, name in enumerate(PLANES) if gm.test(p, insn)]
+            print(f"0x{insn:08X} {','.join(hit) if hit else 'none'}")
+        return 0
+
+    out_dir = Path("decoded_ranges")
+    out_dir.mkdir(parents=True, exist_ok=True)
+
+    for p, name in enumerate(PLANES):
+        out_path = out_dir / f"global_{name}_decoded.txt"
+        total = 0
+        with out_path.open("w", encoding="utf-8") as out:
+            out.write(f"# file: {sys.argv[1]}, kind={name.upper()}\n")
+            out.write("# each line is [start, end) in hex\n\n")
+            for start, end in gm.ranges(p):
+                out.write(f"[0x{start:08X}, 0x{end:08X}]\n")
+                total += end - start
+        print(f"  {name}: {total} encodings -> {out_path}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
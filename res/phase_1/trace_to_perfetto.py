@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+import json
+import struct
+import sys
+from pathlib import Path
+
+# resN_trace.bin（worker -t）：header [file_number int32][record_count uint32][cycles_scope uint32]，
+# 之后是 record_count 条 RangeTraceRecord（见 inc/range_trace.h）
+HEADER = struct.Struct("<iII")
+RECORD = struct.Struct("<IIQQQHh8I")
+OUTCOMES = ("exec", "sigill", "sigsegv", "sigbus", "sigtrap", "sigsys", "timeout", "other")
+CYCLES_SCOPES = ("none", "user", "user+kernel")
+TOP_RANGES = 20
+
+
+def read_trace(bin_path: Path):
+    """读取一个 trace 文件，返回 (file_number, cycles_scope, [record dict, ...])，按开始时间排序"""
+    with bin_path.open("rb") as f:
+        header = f.read(HEADER.size)
+        if len(header) != HEADER.size:
+            raise ValueError(f"{bin_path} header too short")
+
+        file_number, record_count, cycles_scope = HEADER.unpack(header)
+
+        data = f.read(record_count * RECORD.size)
+        if len(data) != record_count * RECORD.size:
+            raise ValueError(
+                f"{bin_path} expected {record_count} records, "
+                f"got {len(data) // RECORD.size}"
+            )
+
+    records = []
+    for start, end, begin_ns, wall_ns, cycles, thread, core, *outcomes in RECORD.iter_unpack(data):
+        records.append({
+            "start": start, "end": end, "begin_ns": begin_ns, "wall_ns": wall_ns,
+            "cycles": cycles, "thread": thread, "core": core,
+            "outcomes": dict(zip(OUTCOMES, outcomes)),
+        })
+
+    # 线程 flush 的顺序和时间顺序无关
+    records.sort(key=lambda r: r["begin_ns"])
+    return file_number, cycles_scope, records
+
+
+def to_events(file_number, cycles_scope, records, t0_ns):
+    """每个 range 一个 complete（"X"）事件：pid 是文件号，tid 是线程"""
+    events = [{"ph": "M", "name": "process_name", "pid": file_number,
+               "args": {"name": f"res{file_number}"}}]
+
+    for thread in sorted({r["thread"] for r in records}):
+        events.append({"ph": "M", "name": "thread_name", "pid": file_number, "tid": thread,
+                       "args": {"name": f"thread {thread}"}})
+
+    for r in records:
+        screened = sum(r["outcomes"].values())
+        args = {
+            "start": f"0x{r['start']:08X}",
+            "end": f"0x{r['end']:08X}",
+            "encodings": r["end"] - r["start"],
+            # T32 里被 prefix probe 剪掉的编码没有执行过
+            "screened": screened,
+            "core": r["core"],
+            "ns_per_encoding": round(r["wall_ns"] / screened, 1) if screened else None,
+        }
+        if cycles_scope:
+            args["cycles"] = r["cycles"]
+            args["cycles_scope"] = CYCLES_SCOPES[cycles_scope]
+        args.update({k: v for k, v in r["outcomes"].items() if v})
+
+        events.append({
+            "ph": "X",
+            "name": f"[0x{r['start']:08X}, 0x{r['end']:08X})",
+            "cat": "range",
+            "pid": file_number,
+            "tid": r["thread"],
+            "ts": (r["begin_ns"] - t0_ns) / 1000.0,
+            "dur": r["wall_ns"] / 1000.0,
+            "args": args,
+        })
+    return events
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(f"usage: {sys.argv[0]} <resN_trace.bin | bitmap dir> [out.json]")
+        print("  open the output in ui.perfetto.dev or chrome://tracing")
+        return 1
+
+    src = Path(sys.argv[1])
+    trace_files = sorted(src.glob("res*_trace.bin")) if src.is_dir() else [src]
+    if not trace_files:
+        print(f"no res*_trace.bin files found in {src}")
+        return 1
+    out_path = Path(sys.argv[2]) if len(sys.argv) > 2 else Path("decoded_ranges") / "trace.json"
+
+    traces = [read_trace(p) for p in trace_files]
+    begins = [r["begin_ns"] for _, _, records in traces for r in records]
+    # 同一次运行的 worker 共用 CLOCK_MONOTONIC，时间轴可以直接对齐
+    t0_ns = min(begins) if begins else 0
+
+    events = []
+    for file_number, cycles_scope, records in traces:
+        events += to_events(file_number, cycles_scope, records, t0_ns)
+        wall = sum(r["wall_ns"] for r in records) / 1e9
+        print(f"  res{file_number}: {len(records)} ranges, {wall:.1f} s, "
+              f"cycles {CYCLES_SCOPES[cycles_scope]}")
+
+    out_path.parent.mkdir(parents=True, exist_ok=True)
+    with out_path.open("w", encoding="utf-8") as out:
+        json.dump({"traceEvents": events, "displayTimeUnit": "ms"}, out)
+    print(f"{len(events)} events -> {out_path}")
+
+    # 最耗时的 range，拆分 range 文件时优先切这些
+    ranked = sorted(((r["wall_ns"], fn, r) for fn, _, records in traces for r in records),
+                    key=lambda x: x[0], reverse=True)
+    print(f"\nslowest {min(TOP_RANGES, len(ranked))} ranges:")
+    for wall_ns, fn, r in ranked[:TOP_RANGES]:
+        screened = sum(r["outcomes"].values())
+        top = max(r["outcomes"], key=r["outcomes"].get) if screened else "-"
+        print(f"  res{fn} [0x{r['start']:08X}, 0x{r['end']:08X}) {wall_ns / 1e6:10.1f} ms "
+              f"{screened:8d} screened, mostly {top}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
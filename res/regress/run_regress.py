@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+"""
+End-to-end regression run for the phase-1 worker.
+
+Screens the golden corpora (corpus_a32.txt, and corpus_t32.txt with
+-m t32) through the real worker binary in a scratch directory, checks every encoding against its expected
+outcome, then times a worker run over a contiguous block and reports
+encodings per second. Works with a native ARM worker or through
+qemu-arm (--runner "qemu-arm -L /usr/arm-linux-gnueabihf").
+"""
+import argparse
+import shlex
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+
+CORPUS_FILE = 1
+BENCH_FILE = 2
+# The worker's screen_modes: input and output directory
+MODE_DIRS = {"a32": ("results_A32", "bitmap_results"),
+             "t32": ("results_T32", "bitmap_results_T32")}
+SIGSEGV = 11
+SIGSYS = 31
+# worker_screen.c, when sandbox_ctx_seccomp() fails
+SECCOMP_MISSING = "no seccomp filter"
+
+FAULT_HEADER = struct.Struct("<iI")
+FAULT_RECORD = struct.Struct("<IBBhIi")
+FAULT_FLAG_LANDED = 0x01
+FAULT_FLAG_EMULATED = 0x02
+FAULT_FLAG_SLOW = 0x04
+FAULT_FLAG_STATE_LOST = 0x08
+
+
+def load_corpus(path: Path):
+    corpus = []
+    for lineno, line in enumerate(path.read_text().splitlines(), 1):
+        line = line.strip()
+        if not line or line.startswith("#"):
+            continue
+        fields = line.split()
+        if len(fields) < 2 or fields[1] not in ("exec", "sigill", "sigsegv", "timeout", "landed", "lost", "emulated", "sigsys"):
+            raise ValueError(f"{path}:{lineno}: expected '<encoding> <outcome>'")
+        corpus.append((int(fields[0], 0), fields[1], " ".join(fields[2:])))
+    return corpus
+
+
+def read_bitmap_set(bin_path: Path):
+    """所有置 1 的指令编码（complete 或 timeout 文件）"""
+    hits = set()
+    if not bin_path.exists():
+        return hits
+
+    with bin_path.open("rb") as f:
+        _, range_count = struct.unpack("<ii", f.read(8))
+        for _ in range(range_count):
+            start, end, size = struct.unpack("<III", f.read(12))
+            bitmap = f.read(size)
+            for offset in range(end - start):
+                if (bitmap[offset // 8] >> (offset % 8)) & 1:
+                    hits.add(start + offset)
+    return hits
+
+
+def read_fault_signals(bin_path: Path):
+    faults = {}
+    if not bin_path.exists():
+        return faults
+
+    data = bin_path.read_bytes()
+    _, record_count = FAULT_HEADER.unpack_from(data)
+    for i in range(record_count):
+        insn, signum, flags, *_ = FAULT_RECORD.unpack_from(data, FAULT_HEADER.size + i * FAULT_RECORD.size)
+        if flags & FAULT_FLAG_LANDED:
+            faults[insn] = "landed"
+        elif flags & FAULT_FLAG_STATE_LOST:
+            faults[insn] = "lost"
+        elif flags & (FAULT_FLAG_EMULATED | FAULT_FLAG_SLOW):
+            faults[insn] = "emulated"
+        else:
+            faults[insn] = signum
+    return faults
+
+
+def run_worker(cmd, workdir: Path, file_number, ranges, extra_args, mode="a32"):
+    input_dir = workdir / MODE_DIRS[mode][0]
+    input_dir.mkdir(exist_ok=True)
+    with (input_dir / f"res{file_number}.txt").open("w") as f:
+        for start, end in ranges:
+            f.write(f"[{start}, {end}]\n")
+
+    argv = cmd + ["-m", mode] + extra_args + [str(file_number)]
+    begin = time.monotonic()
+    proc = subprocess.run(argv, cwd=workdir, stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT, text=True)
+    elapsed = time.monotonic() - begin
+
+    if proc.returncode != 0:
+        sys.stdout.write(proc.stdout)
+        raise RuntimeError(f"{' '.join(argv)} exited with {proc.returncode}")
+    return elapsed, proc.stdout
+
+
+def classify(insn, exec_set, timeout_set, faults):
+    if insn in timeout_set:
+        return "timeout"
+    # Landed and state-lost encodings are in the exec bitmap too
+    if faults.get(insn) == "landed":
+        return "landed"
+    if faults.get(insn) == "lost":
+        return "lost"
+    # Executed through the kernel, kept out of the exec bitmap
+    if faults.get(insn) == "emulated":
+        return "emulated"
+    if insn in exec_set:
+        return "exec"
+    if faults.get(insn) == SIGSEGV:
+        return "sigsegv"
+    if faults.get(insn) == SIGSYS:
+        return "sigsys"
+    if insn in faults:
+        return f"signal {faults[insn]}"
+    return "sigill"
+
+
+def check_corpus(cmd, workdir: Path, corpus, extra_args, mode):
+    _, output = run_worker(cmd, workdir, CORPUS_FILE,
+                           [(insn, insn + 1) for insn, _, _ in corpus], extra_args, mode)
+    # qemu-user rejects PR_SET_SECCOMP, the worker then says so and screens on
+    seccomp = SECCOMP_MISSING not in output
+
+    out_dir = workdir / MODE_DIRS[mode][1]
+    exec_set = read_bitmap_set(out_dir / f"res{CORPUS_FILE}_complete.bin")
+    timeout_set = read_bitmap_set(out_dir / f"res{CORPUS_FILE}_timeout.bin")
+    faults = read_fault_signals(out_dir / f"res{CORPUS_FILE}_faults.bin")
+
+    failures = skipped = 0
+    for insn, expected, comment in corpus:
+        got = classify(insn, exec_set, timeout_set, faults)
+        if expected == "sigsys" and not seccomp:
+            print(f"  skip 0x{insn:08x} {expected:8s} got {got:8s} {comment} (no seccomp filter)")
+            skipped += 1
+            continue
+        status = "ok  " if got == expected else "FAIL"
+        if got != expected:
+            failures += 1
+        print(f"  {status} 0x{insn:08x} {expected:8s} got {got:8s} {comment}")
+    return failures, skipped
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--worker", default="build/worker")
+    parser.add_argument("--runner", default="", help="command prefix, e.g. qemu-arm")
+    parser.add_argument("--worker-args", default="", help="extra worker flags, e.g. '-j 2'")
+    parser.add_argument("--corpus", default=str(Path(__file__).with_name("corpus_a32.txt")))
+    parser.add_argument("--corpus-t32", default=str(Path(__file__).with_name("corpus_t32.txt")))
+    parser.add_argument("--bench-start", type=lambda v: int(v, 0), default=0xe0800000)
+    parser.add_argument("--bench-size", type=lambda v: int(v, 0), default=0x10000)
+    parser.add_argument("--bench-out", default="", help="append the throughput row to this CSV")
+    args = parser.parse_args()
+
+    worker = Path(args.worker).resolve()
+    if not worker.exists():
+        print(f"worker not found: {worker}")
+        return 1
+
+    cmd = shlex.split(args.runner) + [str(worker)]
+    extra_args = shlex.split(args.worker_args)
+    corpora = [("a32", load_corpus(Path(args.corpus))), ("t32", load_corpus(Path(args.corpus_t32)))]
+    total = sum(len(corpus) for _, corpus in corpora)
+
+    with tempfile.TemporaryDirectory(prefix="regress_") as tmp:
+        workdir = Path(tmp)
+
+        failures = skipped = 0
+        for mode, corpus in corpora:
+            print(f"Golden {mode.upper()} corpus: {len(corpus)} encodings")
+            mode_failures, mode_skipped = check_corpus(cmd, workdir, corpus, extra_args, mode)
+            failures += mode_failures
+            skipped += mode_skipped
+
+        bench_end = min(args.bench_start + args.bench_size, 0xffffffff)
+        count = bench_end - args.bench_start
+        elapsed, _ = run_worker(cmd, workdir, BENCH_FILE,
+                                [(args.bench_start, bench_end)], extra_args)
+
+    rate = count / elapsed if elapsed > 0 else 0.0
+    print(f"\nThroughput: {count} encodings in {elapsed:.3f} s = {rate:.0f} enc/s")
+
+    if args.bench_out:
+        out = Path(args.bench_out)
+        out.parent.mkdir(parents=True, exist_ok=True)
+        new_file = not out.exists()
+        with out.open("a") as f:
+            if new_file:
+                f.write("timestamp,runner,worker_args,encodings,seconds,enc_per_s\n")
+            f.write(f"{int(time.time())},{args.runner or 'native'},{args.worker_args},"
+                    f"{count},{elapsed:.3f},{rate:.0f}\n")
+
+    if failures:
+        print(f"\n{failures} of {total} corpus encodings changed outcome")
+        return 1
+
+    print(f"\nAll {total - skipped} checked corpus encodings match"
+          + (f", {skipped} skipped" if skipped else ""))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,271 @@
+#include "core.h"
+#include "sandbox.h"
+
+#define DEFAULT_ITERATIONS  20000
+#define DEFAULT_OUTPUT      "bench_results/sandbox_bench.csv"
+
+#define INSN_NOP    0xe320f000  // nop
+#define INSN_UDF    0xe7f000f0  // udf #0, permanently undefined
+#define INSN_SEGV   0xe5900000  // ldr r0, [r0] with r0 = 0
+
+typedef struct {
+    const char *name;
+    uint64_t    iterations;
+    uint64_t    elapsed_ns;
+    SandboxStats stats;
+} BenchResult;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void stats_delta(SandboxStats *out, const SandboxStats *before)
+{
+    out->mprotect_calls = sandbox_stats.mprotect_calls - before->mprotect_calls;
+    out->timer_calls    = sandbox_stats.timer_calls    - before->timer_calls;
+    out->sigmask_calls  = sandbox_stats.sigmask_calls  - before->sigmask_calls;
+    out->cache_flushes  = sandbox_stats.cache_flushes  - before->cache_flushes;
+    out->signals        = sandbox_stats.signals        - before->signals;
+}
+
+// Whole-candidate cost through the same entry point the worker uses
+static void bench_candidate(BenchResult *r, uint32_t insn, uint64_t iterations)
+{
+    uint8_t insn_bytes[4];
+    size_t len = fill_insn_buffer(insn_bytes, sizeof(insn_bytes), insn);
+    SandboxStats before = sandbox_stats;
+
+    uint64_t t0 = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        execute_insn_page_screen(insn_bytes, len);
+    }
+    r->elapsed_ns = now_ns() - t0;
+    r->iterations = iterations;
+    stats_delta(&r->stats, &before);
+}
+
+static void bench_mprotect(BenchResult *r, uint64_t iterations)
+{
+    uint64_t t0 = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        mprotect(insn_page, PAGE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC);
+    }
+    r->elapsed_ns = now_ns() - t0;
+    r->iterations = iterations;
+    r->stats.mprotect_calls = iterations;
+}
+
+static void bench_memcpy(BenchResult *r, uint64_t iterations)
+{
+    uint8_t insn_bytes[4];
+    size_t len = fill_insn_buffer(insn_bytes, sizeof(insn_bytes), INSN_NOP);
+    volatile uint8_t *dst = (uint8_t *)insn_page + insn_offset * 4;
+
+    uint64_t t0 = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        memcpy((void *)dst, insn_bytes, len);
+    }
+    r->elapsed_ns = now_ns() - t0;
+    r->iterations = iterations;
+}
+
+static void bench_clear_cache(BenchResult *r, uint64_t iterations)
+{
+    char *begin = (char *)insn_page + (insn_offset - 1) * 4;
+    char *end   = (char *)insn_page + insn_offset * 4 + 4;
+
+    uint64_t t0 = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        __builtin___clear_cache(begin, end);
+    }
+    r->elapsed_ns = now_ns() - t0;
+    r->iterations = iterations;
+    r->stats.cache_flushes = iterations;
+}
+
+static void bench_sigsetjmp(BenchResult *r, uint64_t iterations)
+{
+    sigjmp_buf env;
+
+    uint64_t t0 = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        if (sigsetjmp(env, 1) != 0) {
+            break;
+        }
+    }
+    r->elapsed_ns = now_ns() - t0;
+    r->iterations = iterations;
+    r->stats.sigmask_calls = iterations;
+}
+
+static void bench_siglongjmp(BenchResult *r, uint64_t iterations)
+{
+    sigjmp_buf env;
+    volatile uint64_t i = 0;
+
+    uint64_t t0 = now_ns();
+    if (sigsetjmp(env, 1) != 0) {
+        i++;
+    }
+    if (i < iterations) {
+        siglongjmp(env, 1);
+    }
+    r->elapsed_ns = now_ns() - t0;
+    r->iterations = iterations;
+    r->stats.sigmask_calls = iterations * 2;
+}
+
+static void bench_timer(BenchResult *r, uint64_t iterations)
+{
+    uint64_t t0 = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        arm_watchdog_us(WATCHDOG_US);
+        disarm_watchdog();
+    }
+    r->elapsed_ns = now_ns() - t0;
+    r->iterations = iterations;
+    r->stats.timer_calls = iterations * 2;
+}
+
+/*
+ * SIGILL delivery and escape without the per-candidate mprotect/memcpy/flush:
+ * the udf is patched in once and the page is entered directly. Must run
+ * after bench_candidate() has bound the default context to this thread.
+ * Every escape leaves TPIDRURW on the boilerplate's dead frame, so it is
+ * written back each time, as sandbox_ctx_execute() does.
+ */
+static void bench_sigill_delivery(BenchResult *r, uint64_t iterations)
+{
+    uint8_t insn_bytes[4];
+    size_t len = fill_insn_buffer(insn_bytes, sizeof(insn_bytes), INSN_UDF);
+    memcpy((uint8_t *)insn_page + insn_offset * 4, insn_bytes, len);
+    __builtin___clear_cache((char *)insn_page + (insn_offset - 1) * 4,
+                            (char *)insn_page + insn_offset * 4 + len);
+
+    void (*exec_page)(void) = (void (*)(void))insn_page;
+    SandboxContext *ctx = &sandbox_default_ctx;
+    SandboxStats before = sandbox_stats;
+    volatile uint64_t i = 0;
+
+    __asm__ __volatile__("mrc p15, 0, %0, c13, c0, 2" : "=r"(ctx->tpidrurw));
+
+    ctx->executing_insn = 1;
+    uint64_t t0 = now_ns();
+    if (sigsetjmp(ctx->escape_env, 1) != 0) {
+        __asm__ __volatile__("mcr p15, 0, %0, c13, c0, 2" : : "r"(ctx->tpidrurw));
+        i++;
+    }
+    if (i < iterations) {
+        exec_page();
+    }
+    r->elapsed_ns = now_ns() - t0;
+    ctx->executing_insn = 0;
+
+    r->iterations = iterations;
+    stats_delta(&r->stats, &before);
+    r->stats.sigmask_calls += iterations;
+}
+
+static void print_result(FILE *out, const BenchResult *r)
+{
+    double n = r->iterations ? (double)r->iterations : 1.0;
+    uint64_t syscalls = r->stats.mprotect_calls + r->stats.timer_calls +
+                        r->stats.sigmask_calls + r->stats.cache_flushes;
+
+    fprintf(out, "%s,%" PRIu64 ",%.1f,%.2f,%.2f\n",
+            r->name, r->iterations, (double)r->elapsed_ns / n,
+            (double)syscalls / n, (double)r->stats.signals / n);
+
+    printf("  %-18s %10.1f ns/op  %5.2f syscalls/op  %5.2f signals/op\n",
+           r->name, (double)r->elapsed_ns / n,
+           (double)syscalls / n, (double)r->stats.signals / n);
+}
+
+int main(int argc, const char *argv[])
+{
+    const char *output_path = (argc > 1) ? argv[1] : DEFAULT_OUTPUT;
+    uint64_t iterations = DEFAULT_ITERATIONS;
+    if (argc > 2) {
+        iterations = strtoull(argv[2], NULL, 0);
+        if (iterations == 0) {
+            fprintf(stderr, "Usage: %s [output.csv] [iterations]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    sigset_t empty_set;
+    sigemptyset(&empty_set);
+    pthread_sigmask(SIG_SETMASK, &empty_set, NULL);
+
+    init_signal_handler(signal_handler, SIGILL,    SA_NONE);
+    init_signal_handler(signal_handler, SIGSEGV,   SA_NONE);
+    init_signal_handler(signal_handler, SIGTRAP,   SA_NONE);
+    init_signal_handler(signal_handler, SIGBUS,    SA_NONE);
+
+    init_signal_handler(signal_handler, SIGRTMIN,  SA_NODEFER);
+    init_signal_handler(signal_handler, SIGVTALRM, SA_NODEFER);
+
+    if (init_watchdog_timer() != 0) {
+        fprintf(stderr, "Failed to initialize watchdog timer\n");
+        return 1;
+    }
+
+    if (init_insn_page() != 0) {
+        perror("insn_page mmap failed");
+        timer_delete(watchdog_timer);
+        return 1;
+    }
+
+    char dir_buf[256];
+    snprintf(dir_buf, sizeof(dir_buf), "%s", output_path);
+    mkdir(dirname(dir_buf), 0755);
+
+    FILE *out = fopen(output_path, "w");
+    if (!out) {
+        perror("fopen bench output");
+        munmap(insn_region, PAGE_SIZE * 3);
+        timer_delete(watchdog_timer);
+        return 1;
+    }
+
+    fprintf(out, "stage,iterations,ns_per_op,syscalls_per_op,signals_per_op\n");
+    printf("sandbox bench: %" PRIu64 " iterations per stage\n", iterations);
+
+    BenchResult results[] = {
+        { .name = "candidate_nop"     },
+        { .name = "candidate_sigill"  },
+        { .name = "candidate_sigsegv" },
+        { .name = "mprotect"          },
+        { .name = "memcpy"            },
+        { .name = "clear_cache"       },
+        { .name = "sigsetjmp"         },
+        { .name = "siglongjmp"        },
+        { .name = "timer_arm_disarm"  },
+        { .name = "sigill_delivery"   },
+    };
+
+    bench_candidate(&results[0], INSN_NOP,  iterations);
+    bench_candidate(&results[1], INSN_UDF,  iterations);
+    bench_candidate(&results[2], INSN_SEGV, iterations);
+    bench_mprotect(&results[3], iterations);
+    bench_memcpy(&results[4], iterations);
+    bench_clear_cache(&results[5], iterations);
+    bench_sigsetjmp(&results[6], iterations);
+    bench_siglongjmp(&results[7], iterations);
+    bench_timer(&results[8], iterations);
+    bench_sigill_delivery(&results[9], iterations);
+
+    for (size_t i = 0; i < sizeof(results) / sizeof(results[0]); i++) {
+        print_result(out, &results[i]);
+    }
+
+    fclose(out);
+    printf("results written to %s\n", output_path);
+
+    timer_delete(watchdog_timer);
+    munmap(insn_region, PAGE_SIZE * 3);
+    return 0;
+}
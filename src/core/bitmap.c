@@ -1,37 +1,290 @@
 #include "bitmap.h"
 
-static int bitmap_has_data(const uint8_t *bitmap, uint32_t size)
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/*
+ * Two-input word operations. The NEON body handles two words per step,
+ * the scalar loop finishes the tail (or everything without NEON).
+ */
+#if defined(__ARM_NEON)
+#define BITMAP_BINARY_OP(name, neon_op, scalar_expr)                        \
+void name(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t words) \
+{                                                                           \
+    size_t i = 0;                                                           \
+    for (; i + 2 <= words; i += 2) {                                        \
+        vst1q_u64(dst + i, neon_op(vld1q_u64(a + i), vld1q_u64(b + i)));    \
+    }                                                                       \
+    for (; i < words; i++) {                                                \
+        dst[i] = scalar_expr;                                               \
+    }                                                                       \
+}
+#else
+#define BITMAP_BINARY_OP(name, neon_op, scalar_expr)                        \
+void name(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t words) \
+{                                                                           \
+    for (size_t i = 0; i < words; i++) {                                    \
+        dst[i] = scalar_expr;                                               \
+    }                                                                       \
+}
+#endif
+
+BITMAP_BINARY_OP(bitmap_or,     vorrq_u64, a[i] | b[i])
+BITMAP_BINARY_OP(bitmap_and,    vandq_u64, a[i] & b[i])
+BITMAP_BINARY_OP(bitmap_xor,    veorq_u64, a[i] ^ b[i])
+BITMAP_BINARY_OP(bitmap_andnot, vbicq_u64, a[i] & ~b[i])
+
+uint64_t bitmap_popcount(const uint64_t *map, size_t words)
+{
+    uint64_t count = 0;
+    size_t i = 0;
+
+#if defined(__ARM_NEON)
+    uint64x2_t acc = vdupq_n_u64(0);
+
+    // vcnt per byte, then widen pairwise into the two u64 lanes
+    for (; i + 2 <= words; i += 2) {
+        uint8x16_t bytes = vcntq_u8(vreinterpretq_u8_u64(vld1q_u64(map + i)));
+        acc = vaddq_u64(acc, vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(bytes))));
+    }
+    count = vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+#endif
+
+    for (; i < words; i++) {
+        count += (uint64_t)__builtin_popcountll(map[i]);
+    }
+    return count;
+}
+
+int bitmap_any(const uint64_t *map, size_t words)
 {
-    if (!bitmap || size == 0) {
-        return 0;
+    if (!map) return 0;
+
+    size_t i = 0;
+
+#if defined(__ARM_NEON)
+    // Fold eight words per step, one early-out check per step
+    for (; i + 8 <= words; i += 8) {
+        uint64x2_t acc = vorrq_u64(vorrq_u64(vld1q_u64(map + i),     vld1q_u64(map + i + 2)),
+                                   vorrq_u64(vld1q_u64(map + i + 4), vld1q_u64(map + i + 6)));
+        if (vgetq_lane_u64(acc, 0) | vgetq_lane_u64(acc, 1)) {
+            return 1;
+        }
     }
+#endif
 
-    for (uint32_t i = 0; i < size; i++) {
-        if (bitmap[i] != 0) {
+    for (; i < words; i++) {
+        if (map[i] != 0) {
             return 1;
         }
     }
     return 0;
 }
 
-static void bitmap_set_bit(uint8_t *bitmap,
-                           uint32_t bits,
-                           uint32_t start,
-                           uint32_t insn)
+// invert is all ones to search for clear bits
+static size_t bitmap_next(const uint64_t *map, size_t bits, size_t from, uint64_t invert)
 {
-    if (!bitmap) return;
+    if (from >= bits) {
+        return bits;
+    }
 
-    if (insn < start) return;
-    uint32_t offset = insn - start;
+    size_t words = BITMAP_WORDS(bits);
+    size_t w = from / BITMAP_WORD_BITS;
+    uint64_t cur = (map[w] ^ invert) & (~0ULL << (from % BITMAP_WORD_BITS));
 
-    if (offset >= bits) {
-        return;
+    for (;;) {
+        if (cur) {
+            size_t bit = w * BITMAP_WORD_BITS + (size_t)__builtin_ctzll(cur);
+            return (bit < bits) ? bit : bits;
+        }
+        if (++w >= words) {
+            return bits;
+        }
+        cur = map[w] ^ invert;
+    }
+}
+
+size_t bitmap_next_set(const uint64_t *map, size_t bits, size_t from)
+{
+    return bitmap_next(map, bits, from, 0);
+}
+
+size_t bitmap_next_clear(const uint64_t *map, size_t bits, size_t from)
+{
+    return bitmap_next(map, bits, from, ~0ULL);
+}
+
+void bitmap_or_bits(uint64_t *dst, size_t dst_off, const uint64_t *src, size_t src_off, size_t n)
+{
+    while (n > 0) {
+        size_t src_word = src_off / BITMAP_WORD_BITS;
+        size_t src_bit  = src_off % BITMAP_WORD_BITS;
+        size_t dst_bit  = dst_off % BITMAP_WORD_BITS;
+
+        // Take as many bits as fit in the current destination word
+        size_t take = BITMAP_WORD_BITS - dst_bit;
+        if (take > n) {
+            take = n;
+        }
+
+        uint64_t v = src[src_word] >> src_bit;
+        if (src_bit != 0 && BITMAP_WORD_BITS - src_bit < take) {
+            v |= src[src_word + 1] << (BITMAP_WORD_BITS - src_bit);
+        }
+        if (take < BITMAP_WORD_BITS) {
+            v &= (1ULL << take) - 1;
+        }
+
+        dst[dst_off / BITMAP_WORD_BITS] |= v << dst_bit;
+
+        dst_off += take;
+        src_off += take;
+        n       -= take;
+    }
+}
+
+void bitmap_set_bits(uint64_t *map, size_t from, size_t n)
+{
+    while (n > 0) {
+        size_t bit  = from % BITMAP_WORD_BITS;
+        size_t take = BITMAP_WORD_BITS - bit;
+        if (take > n) {
+            take = n;
+        }
+
+        uint64_t v = (take < BITMAP_WORD_BITS) ? ((1ULL << take) - 1) : ~0ULL;
+        map[from / BITMAP_WORD_BITS] |= v << bit;
+
+        from += take;
+        n    -= take;
     }
+}
 
-    uint32_t byte_index  = offset / 8;
-    uint8_t  bit_position = offset % 8;
+static int cmp_bitmap_range(const void *a, const void *b)
+{
+    const BitmapRange *ra = (const BitmapRange *)a;
+    const BitmapRange *rb = (const BitmapRange *)b;
+    return (ra->start > rb->start) - (ra->start < rb->start);
+}
+
+int bitmap_file_load(BitmapFile *bf, const char *path)
+{
+    if (!bf || !path) return -1;
+
+    memset(bf, 0, sizeof(*bf));
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+
+    int32_t header[2];
+    if (fread(header, sizeof(int32_t), 2, f) != 2 || header[1] < 0) {
+        fprintf(stderr, "%s: header too short\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    bf->file_number = header[0];
+    bf->ranges = (BitmapRange *)calloc(header[1] ? header[1] : 1, sizeof(BitmapRange));
+    if (!bf->ranges) {
+        perror("calloc bitmap ranges failed");
+        fclose(f);
+        return -1;
+    }
+
+    for (int32_t i = 0; i < header[1]; i++) {
+        uint32_t rec[3];
+        if (fread(rec, sizeof(uint32_t), 3, f) != 3) {
+            fprintf(stderr, "%s: range %d header too short\n", path, i);
+            goto fail;
+        }
+
+        uint32_t start = rec[0], end = rec[1], size = rec[2];
+        if (end <= start || size != (end - start + 7u) / 8u) {
+            fprintf(stderr, "%s: range %d has a bad bitmap size\n", path, i);
+            goto fail;
+        }
+
+        uint64_t *map = (uint64_t *)calloc(BITMAP_WORDS(end - start), sizeof(uint64_t));
+        if (!map) {
+            perror("calloc bitmap failed");
+            goto fail;
+        }
+
+        BitmapRange *r = &bf->ranges[bf->count++];
+        r->start = start;
+        r->end   = end;
+        r->map   = map;
+
+        if (fread(map, 1, size, f) != size) {
+            fprintf(stderr, "%s: range %d bitmap too short\n", path, i);
+            goto fail;
+        }
+    }
+
+    fclose(f);
+    qsort(bf->ranges, bf->count, sizeof(BitmapRange), cmp_bitmap_range);
+    return 0;
+
+fail:
+    fclose(f);
+    bitmap_file_free(bf);
+    return -1;
+}
+
+void bitmap_file_free(BitmapFile *bf)
+{
+    if (!bf) return;
+
+    for (int i = 0; i < bf->count; i++) {
+        free(bf->ranges[i].map);
+    }
+    free(bf->ranges);
+    memset(bf, 0, sizeof(*bf));
+}
+
+void bitmap_file_extract(const BitmapFile *bf, uint32_t start, uint32_t end,
+                         uint64_t *dst, uint64_t *covered)
+{
+    if (!bf || end <= start) return;
+
+    // First range ending after start
+    int lo = 0, hi = bf->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (bf->ranges[mid].end <= start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    for (int i = lo; i < bf->count && bf->ranges[i].start < end; i++) {
+        const BitmapRange *r = &bf->ranges[i];
+        uint32_t from = (r->start > start) ? r->start : start;
+        uint32_t to   = (r->end < end) ? r->end : end;
+
+        if (dst) {
+            bitmap_or_bits(dst, from - start, r->map, from - r->start, to - from);
+        }
+        if (covered) {
+            bitmap_set_bits(covered, from - start, to - from);
+        }
+    }
+}
+
+static void range_bitmap_set(uint64_t *map, const RangeBitmap *rb, uint32_t insn)
+{
+    if (insn < rb->start) return;
+    uint32_t offset = insn - rb->start;
+
+    if (offset >= rb->bits) {
+        return;
+    }
 
-    bitmap[byte_index] |= (uint8_t)(1u << bit_position);
+    bitmap_set(map, offset);
 }
 
 
@@ -42,16 +295,18 @@ int range_bitmap_init(RangeBitmap *rb, uint32_t start, uint32_t end)
         return -1;
     }
 
-    uint32_t bits = end - start;
-    uint32_t size = (bits + 7u) / 8u;
+    uint32_t bits  = end - start;
+    uint32_t size  = (bits + 7u) / 8u;
+    size_t   words = BITMAP_WORDS(bits);
 
-    uint8_t *exec = (uint8_t *)calloc(size, 1);
+    // Whole words so the tail can be handled a word at a time
+    uint64_t *exec = (uint64_t *)calloc(words, sizeof(uint64_t));
     if (!exec) {
         perror("calloc exec_bitmap failed");
         return -1;
     }
 
-    uint8_t *timeout = (uint8_t *)calloc(size, 1);
+    uint64_t *timeout = (uint64_t *)calloc(words, sizeof(uint64_t));
     if (!timeout) {
         perror("calloc timeout_bitmap failed");
         free(exec);
@@ -71,19 +326,19 @@ int range_bitmap_init(RangeBitmap *rb, uint32_t start, uint32_t end)
 void range_bitmap_mark_exec(RangeBitmap *rb, uint32_t insn)
 {
     if (!rb || !rb->exec_bitmap) return;
-    bitmap_set_bit(rb->exec_bitmap, rb->bits, rb->start, insn);
+    range_bitmap_set(rb->exec_bitmap, rb, insn);
 }
 
 void range_bitmap_mark_timeout(RangeBitmap *rb, uint32_t insn)
 {
     if (!rb || !rb->timeout_bitmap) return;
-    bitmap_set_bit(rb->timeout_bitmap, rb->bits, rb->start, insn);
+    range_bitmap_set(rb->timeout_bitmap, rb, insn);
 }
 
 int range_bitmap_has_timeout(const RangeBitmap *rb)
 {
     if (!rb || !rb->timeout_bitmap) return 0;
-    return bitmap_has_data(rb->timeout_bitmap, rb->size);
+    return bitmap_any(rb->timeout_bitmap, BITMAP_WORDS(rb->bits));
 }
 
 int range_bitmap_flush(const RangeBitmap *rb,
@@ -112,7 +367,7 @@ int range_bitmap_flush(const RangeBitmap *rb,
 
     // timeout 文件：只有有数据时才写
     if (timeout_file && rb->timeout_bitmap &&
-        bitmap_has_data(rb->timeout_bitmap, rb->size))
+        bitmap_any(rb->timeout_bitmap, BITMAP_WORDS(rb->bits)))
     {
         if (fwrite(&rb->start, sizeof(uint32_t), 1, timeout_file) != 1) {
             return -1;
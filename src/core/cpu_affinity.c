@@ -1,4 +1,8 @@
 #include "cpu_affinity.h"
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
 
 int set_cpu_affinity(pid_t pid, int core_id) {
     cpu_set_t mask;
@@ -13,4 +17,225 @@ int set_cpu_affinity(pid_t pid, int core_id) {
     mlockall(MCL_CURRENT | MCL_FUTURE);
 
     return 0;
-}
\ No newline at end of file
+}
+
+// Kernel cpulist format: "2-3,6", empty or "(null)" when unset
+static void parse_cpulist(const char *path, cpu_set_t *set)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return;
+    }
+
+    char buf[1024];
+    if (!fgets(buf, sizeof(buf), f)) {
+        fclose(f);
+        return;
+    }
+    fclose(f);
+
+    char *p = buf;
+    while (*p >= '0' && *p <= '9') {
+        char *next;
+        long lo = strtol(p, &next, 10);
+        long hi = lo;
+        if (*next == '-') {
+            hi = strtol(next + 1, &next, 10);
+        }
+        for (long cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, set);
+        }
+        p = (*next == ',') ? next + 1 : next;
+    }
+}
+
+int cpu_isolated_set(cpu_set_t *set)
+{
+    CPU_ZERO(set);
+    parse_cpulist("/sys/devices/system/cpu/isolated", set);
+    parse_cpulist("/sys/devices/system/cpu/nohz_full", set);
+    return CPU_COUNT(set);
+}
+
+int cpu_pick_low_jitter(int index)
+{
+    cpu_set_t allowed, isolated;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+        perror("sched_getaffinity failed");
+        return -1;
+    }
+    cpu_isolated_set(&isolated);
+
+    int order[CPU_SETSIZE];
+    int n = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed) && (CPU_ISSET(cpu, &isolated) != 0) == (pass == 0)) {
+                order[n++] = cpu;
+            }
+        }
+    }
+
+    return n ? order[index % n] : -1;
+}
+
+int set_realtime_fifo(int priority)
+{
+    struct rlimit rt = {
+        .rlim_cur = LOWJITTER_RTTIME_SOFT_US,
+        .rlim_max = LOWJITTER_RTTIME_HARD_US,
+    };
+    // Without a limit a wedged FIFO thread owns its core for good
+    if (setrlimit(RLIMIT_RTTIME, &rt) < 0) {
+        perror("setrlimit RLIMIT_RTTIME failed");
+        return -1;
+    }
+
+    struct sched_param param = { .sched_priority = priority };
+    if (sched_setscheduler(0, SCHED_FIFO, &param) < 0) {
+        perror("Setting SCHED_FIFO failed");
+        return -1;
+    }
+
+    return 0;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void jitter_probe(JitterReport *r, uint32_t duration_ms, uint64_t limit_ns)
+{
+    memset(r, 0, sizeof(*r));
+
+    uint64_t start = now_ns();
+    uint64_t stop  = start + (uint64_t)duration_ms * 1000000ull;
+    uint64_t prev  = start;
+
+    for (;;) {
+        uint64_t t = now_ns();
+        uint64_t gap = t - prev;
+
+        r->samples++;
+        if (gap > r->max_gap_ns) r->max_gap_ns = gap;
+        if (gap > JITTER_GAP_NS) r->gaps_over++;
+        if (gap > limit_ns)      r->gaps_over_limit++;
+
+        prev = t;
+        if (t >= stop) {
+            break;
+        }
+    }
+
+    r->duration_s = (prev - start) / 1e9;
+}
+
+static int midr_from_sysfs(int cpu, uint32_t *midr)
+{
+    char path[128];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/regs/identification/midr_el1", cpu);
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+
+    unsigned long long value;
+    int ok = fscanf(f, "%llx", &value) == 1;
+    fclose(f);
+
+    if (!ok) {
+        return -1;
+    }
+    *midr = (uint32_t)value;
+    return 0;
+}
+
+// The fields follow each "processor : N" line, one block per core
+static int midr_from_cpuinfo(int cpu, uint32_t *midr)
+{
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (!f) {
+        return -1;
+    }
+
+    char line[256];
+    int current = -1, found = 0;
+    unsigned int impl = 0, variant = 0, part = 0, rev = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        char *colon = strchr(line, ':');
+        if (!colon) {
+            continue;
+        }
+        unsigned int v = (unsigned int)strtoul(colon + 1, NULL, 0);
+
+        if (strncmp(line, "processor", 9) == 0) {
+            if (current == cpu) {
+                break;
+            }
+            current = (int)v;
+        } else if (current != cpu) {
+            continue;
+        } else if (strncmp(line, "CPU implementer", 15) == 0) {
+            impl = v;
+            found |= 1;
+        } else if (strncmp(line, "CPU variant", 11) == 0) {
+            variant = v;
+        } else if (strncmp(line, "CPU part", 8) == 0) {
+            part = v;
+            found |= 2;
+        } else if (strncmp(line, "CPU revision", 12) == 0) {
+            rev = v;
+        }
+    }
+    fclose(f);
+
+    if (found != 3) {
+        return -1;
+    }
+    // Architecture field 0xf: the ID scheme is in the CPUID registers
+    *midr = (impl << 24) | ((variant & 0xf) << 20) | (0xfu << 16) | ((part & 0xfff) << 4) | (rev & 0xf);
+    return 0;
+}
+
+int cpu_midr(int cpu, uint32_t *midr)
+{
+    if (midr_from_sysfs(cpu, midr) == 0 || midr_from_cpuinfo(cpu, midr) == 0) {
+        return 0;
+    }
+    return -1;
+}
+
+typedef struct {
+    uint32_t    impl_part;                 // implementer << 12 | part number
+    const char *name;
+} CoreName;
+
+static const CoreName core_names[] = {
+    { 0x41c07, "cortex-a7"   }, { 0x41c09, "cortex-a9"   }, { 0x41c0d, "cortex-a12"  },
+    { 0x41c0e, "cortex-a17"  }, { 0x41c0f, "cortex-a15"  }, { 0x41d03, "cortex-a53"  },
+    { 0x41d04, "cortex-a35"  }, { 0x41d05, "cortex-a55"  }, { 0x41d07, "cortex-a57"  },
+    { 0x41d08, "cortex-a72"  }, { 0x41d09, "cortex-a73"  }, { 0x41d0a, "cortex-a75"  },
+    { 0x41d0b, "cortex-a76"  }, { 0x41d0d, "cortex-a77"  }, { 0x41d41, "cortex-a78"  },
+    { 0x41d44, "cortex-x1"   }, { 0x41d46, "cortex-a510" }, { 0x41d47, "cortex-a710" },
+    { 0x41d48, "cortex-x2"   }, { 0x41d4d, "cortex-a715" }, { 0x41d4e, "cortex-x3"   },
+};
+
+void midr_tag(uint32_t midr, char *buf, size_t len)
+{
+    uint32_t impl_part = ((midr >> 24) << 12) | ((midr >> 4) & 0xfff);
+
+    for (size_t i = 0; i < sizeof(core_names) / sizeof(core_names[0]); i++) {
+        if (core_names[i].impl_part == impl_part) {
+            snprintf(buf, len, "%s_r%up%u", core_names[i].name, (midr >> 20) & 0xf, midr & 0xf);
+            return;
+        }
+    }
+    snprintf(buf, len, "midr_%08x", midr);
+}
@@ -0,0 +1,91 @@
+#include "emulation.h"
+
+typedef struct {
+    const char *name;                      // /proc/sys/abi/<name>
+    int         cls;
+} AbiKnob;
+
+static const AbiKnob abi_knobs[] = {
+    { "swp",          EMU_SWP          },
+    { "setend",       EMU_SETEND       },
+    { "cp15_barrier", EMU_CP15_BARRIER },
+};
+
+void emulation_config_load(EmulationConfig *emu)
+{
+    emu->active = 0;
+
+    for (size_t i = 0; i < sizeof(abi_knobs) / sizeof(abi_knobs[0]); i++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/sys/abi/%s", abi_knobs[i].name);
+
+        FILE *f = fopen(path, "r");
+        if (!f) {
+            continue;
+        }
+        int mode = 0;
+        if (fscanf(f, "%d", &mode) == 1 && mode == EMU_ABI_EMULATE) {
+            emu->active |= abi_knobs[i].cls;
+        }
+        fclose(f);
+    }
+}
+
+const char *emulation_describe(const EmulationConfig *emu, char *buf, size_t len)
+{
+    size_t used = 0;
+
+    buf[0] = '\0';
+    for (size_t i = 0; i < sizeof(abi_knobs) / sizeof(abi_knobs[0]); i++) {
+        if ((emu->active & abi_knobs[i].cls) && used < len) {
+            used += (size_t)snprintf(buf + used, len - used, "%s%s",
+                                     used ? " " : "", abi_knobs[i].name);
+        }
+    }
+    return used ? buf : "none";
+}
+
+/*
+ * Same masks as the kernel's undef hooks (arch/arm64/kernel/armv8_deprecated.c).
+ * SWP and the CP15 barriers are A32 only and the kernel leaves their
+ * unconditional (cond 0xf) forms alone; SETEND also exists as a 16-bit T32.
+ */
+int emulation_match(const EmulationConfig *emu, uint32_t insn, int thumb)
+{
+    int cls = 0;
+
+    if (thumb) {
+        // 16-bit encodings are screened as hw1:0000
+        if ((insn & 0xfff7ffff) == 0xb6500000) {
+            cls = EMU_SETEND;
+        }
+        return cls & emu->active;
+    }
+
+    if ((insn & 0xfffffdff) == 0xf1010000) {
+        cls = EMU_SETEND;
+    } else if ((insn >> 28) != 0xf) {
+        if ((insn & 0x0fb00ff0) == 0x01000090) {
+            cls = EMU_SWP;
+        } else if ((insn & 0x0fff0fdf) == 0x0e070f9a ||      // DSB, DMB
+                   (insn & 0x0fff0fff) == 0x0e070f95) {      // ISB
+            cls = EMU_CP15_BARRIER;
+        }
+    }
+    return cls & emu->active;
+}
+
+int latency_is_outlier(LatencyBaseline *lb, uint32_t exec_ns)
+{
+    if (lb->samples >= LATENCY_WARMUP &&
+        exec_ns > lb->base_ns * LATENCY_FACTOR &&
+        exec_ns > lb->base_ns + LATENCY_MIN_EXCESS_NS) {
+        return 1;
+    }
+
+    // Plain average while warming up, then weight 1/LATENCY_WARMUP
+    lb->samples++;
+    double weight = (lb->samples < LATENCY_WARMUP) ? 1.0 / lb->samples : 1.0 / LATENCY_WARMUP;
+    lb->base_ns += ((double)exec_ns - lb->base_ns) * weight;
+    return 0;
+}
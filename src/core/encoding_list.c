@@ -0,0 +1,67 @@
+#include "encoding_list.h"
+
+void encoding_reader_init(EncodingReader *r, FILE *in)
+{
+    r->in   = in;
+    r->next = 0;
+    r->end  = 0;
+}
+
+// Returns 1 and fills [start, end) for a usable line
+static int parse_line(const char *line, uint64_t *start, uint64_t *end)
+{
+    while (*line == ' ' || *line == '\t') line++;
+
+    if (*line == '#' || *line == '\n' || *line == '\0') {
+        return 0;
+    }
+
+    if (*line == '[') {
+        if (sscanf(line, "[ %" SCNi64 " , %" SCNi64 " ]", start, end) != 2 ||
+            *end <= *start || *start > UINT32_MAX) {
+            return 0;
+        }
+        if (*end > (uint64_t)UINT32_MAX + 1) {
+            *end = (uint64_t)UINT32_MAX + 1;
+        }
+        return 1;
+    }
+
+    char *stop;
+    errno = 0;
+    unsigned long long insn = strtoull(line, &stop, 16);
+    if (stop == line || errno != 0 || insn > UINT32_MAX) {
+        return 0;
+    }
+
+    *start = insn;
+    *end   = insn + 1;
+    return 1;
+}
+
+int encoding_reader_next(EncodingReader *r, uint32_t *insn)
+{
+    char line[256];
+
+    while (r->next >= r->end) {
+        if (fgets(line, sizeof(line), r->in) == NULL) {
+            return 0;
+        }
+
+        uint64_t start, end;
+        if (!parse_line(line, &start, &end)) {
+            continue;
+        }
+        if (end - start > ENCODING_MAX_RANGE) {
+            fprintf(stderr, "skipping range [0x%08" PRIx64 ", 0x%08" PRIx64 "): too large\n",
+                    start, end);
+            continue;
+        }
+
+        r->next = start;
+        r->end  = end;
+    }
+
+    *insn = (uint32_t)r->next++;
+    return 1;
+}
@@ -0,0 +1,143 @@
+#include "fault_log.h"
+
+int fault_log_open(FaultLogFile *lf, const char *path, int file_number)
+{
+    if (!lf || !path) return -1;
+
+    memset(lf, 0, sizeof(*lf));
+
+    lf->file = fopen(path, "wb");
+    if (!lf->file) {
+        fprintf(stderr, "failed to create %s\n", path);
+        return -1;
+    }
+
+    lf->file_number = file_number;
+
+    // header：[file_number][record_count]，count is written back on close
+    if (fwrite(&lf->file_number, sizeof(int), 1, lf->file) != 1 ||
+        fwrite(&lf->record_count, sizeof(uint32_t), 1, lf->file) != 1) {
+        fclose(lf->file);
+        lf->file = NULL;
+        return -1;
+    }
+
+    pthread_mutex_init(&lf->lock, NULL);
+    return 0;
+}
+
+int fault_log_close(FaultLogFile *lf)
+{
+    if (!lf || !lf->file) return -1;
+
+    int ret = 0;
+    if (fseek(lf->file, sizeof(int), SEEK_SET) != 0 ||
+        fwrite(&lf->record_count, sizeof(uint32_t), 1, lf->file) != 1) {
+        ret = -1;
+    }
+
+    if (fclose(lf->file) != 0) {
+        ret = -1;
+    }
+    lf->file = NULL;
+    pthread_mutex_destroy(&lf->lock);
+    return ret;
+}
+
+void fault_log_init(FaultLog *log, FaultLogFile *out)
+{
+    log->out   = out;
+    log->count = 0;
+}
+
+void fault_record_from_ctx(FaultRecord *rec, uint32_t insn, const SandboxContext *ctx)
+{
+    uint32_t location = (uint32_t)(uintptr_t)ctx->insn_page + ctx->insn_offset * 4;
+
+    rec->insn       = insn;
+    rec->signum     = (uint8_t)ctx->last_insn_signum;
+    rec->flags      = (ctx->landed ? FAULT_FLAG_LANDED : 0) |
+                      (ctx->state_lost ? FAULT_FLAG_STATE_LOST : 0);
+    rec->si_code    = (int16_t)ctx->fault_code;
+    rec->fault_addr = ctx->fault_addr;
+    rec->pc_offset  = (int32_t)(ctx->fault_pc - location);
+}
+
+int fault_log_append(FaultLog *log, const FaultRecord *rec)
+{
+    if (!log || !log->out) return 0;
+
+    log->records[log->count++] = *rec;
+
+    if (log->count == FAULT_LOG_BUFFER) {
+        return fault_log_flush(log);
+    }
+    return 0;
+}
+
+int fault_log_flush(FaultLog *log)
+{
+    if (!log || !log->out || log->count == 0) return 0;
+
+    FaultLogFile *lf = log->out;
+    int ret = 0;
+
+    pthread_mutex_lock(&lf->lock);
+    if (fwrite(log->records, sizeof(FaultRecord), log->count, lf->file) != log->count) {
+        ret = -1;
+    } else {
+        lf->record_count += log->count;
+    }
+    pthread_mutex_unlock(&lf->lock);
+
+    log->count = 0;
+    return ret;
+}
+
+static int cmp_fault_record(const void *a, const void *b)
+{
+    uint32_t ia = ((const FaultRecord *)a)->insn;
+    uint32_t ib = ((const FaultRecord *)b)->insn;
+    return (ia > ib) - (ia < ib);
+}
+
+int fault_log_load(const char *path, FaultRecord **records_out, uint32_t *count_out)
+{
+    if (!path || !records_out || !count_out) return -1;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+
+    int file_number;
+    uint32_t count;
+    if (fread(&file_number, sizeof(int), 1, f) != 1 ||
+        fread(&count, sizeof(uint32_t), 1, f) != 1) {
+        fprintf(stderr, "%s: header too short\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    FaultRecord *records = (FaultRecord *)malloc((count ? count : 1) * sizeof(FaultRecord));
+    if (!records) {
+        perror("malloc fault records failed");
+        fclose(f);
+        return -1;
+    }
+
+    if (fread(records, sizeof(FaultRecord), count, f) != count) {
+        fprintf(stderr, "%s: expected %u records\n", path, count);
+        free(records);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    // Threads flush their buffers in any order
+    qsort(records, count, sizeof(FaultRecord), cmp_fault_record);
+
+    *records_out = records;
+    *count_out   = count;
+    return 0;
+}
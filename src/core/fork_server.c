@@ -0,0 +1,186 @@
+#include "fork_server.h"
+
+int fork_server_init(ForkServer *fs, SandboxContext *ctx, uint32_t batch_size,
+                     fork_exec_t exec_fn, fork_record_t record_fn, void *arg,
+                     FILE *crash_file)
+{
+    if (!fs || !ctx || batch_size == 0 || !exec_fn || !record_fn) {
+        return -1;
+    }
+
+    memset(fs, 0, sizeof(*fs));
+
+    fs->outcomes = mmap(NULL, batch_size * sizeof(FaultRecord), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (fs->outcomes == MAP_FAILED) {
+        perror("mmap fork server outcomes failed");
+        fs->outcomes = NULL;
+        return -1;
+    }
+
+    fs->ctx        = ctx;
+    fs->batch_size = batch_size;
+    fs->exec_fn    = exec_fn;
+    fs->record_fn  = record_fn;
+    fs->arg        = arg;
+    fs->crash_file = crash_file;
+
+    return 0;
+}
+
+void fork_server_destroy(ForkServer *fs)
+{
+    if (!fs) return;
+
+    if (fs->outcomes) {
+        munmap(fs->outcomes, fs->batch_size * sizeof(FaultRecord));
+        fs->outcomes = NULL;
+    }
+}
+
+static void run_child(ForkServer *fs, uint32_t start, uint32_t count)
+{
+    if (sandbox_ctx_after_fork(fs->ctx) != 0) {
+        _exit(2);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t insn = start + i;
+
+        if (fs->exec_fn(fs->ctx, insn, fs->arg) < 0) {
+            fs->outcomes[i].signum = FORK_OUTCOME_SKIPPED;
+        } else {
+            fault_record_from_ctx(&fs->outcomes[i], insn, fs->ctx);
+        }
+    }
+
+    _exit(0);
+}
+
+// Returns 0 when the child screened the whole batch, otherwise the wait status
+static int run_batch(ForkServer *fs, uint32_t start, uint32_t count, int *status_out)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        fs->outcomes[i].signum = FORK_OUTCOME_PENDING;
+    }
+
+    // The child must not inherit unflushed output it could write twice
+    fflush(NULL);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        return -1;
+    }
+    if (pid == 0) {
+        run_child(fs, start, count);
+    }
+
+    fs->forks++;
+
+    uint64_t budget_us = FORK_BATCH_BASE_US + (uint64_t)count * FORK_BATCH_PER_INSN_US;
+    uint64_t waited_us = 0;
+    int status = 0;
+
+    for (;;) {
+        pid_t ret = waitpid(pid, &status, WNOHANG);
+        if (ret == pid) {
+            break;
+        }
+        if (ret < 0 && errno != EINTR) {
+            perror("waitpid failed");
+            return -1;
+        }
+
+        if (waited_us >= budget_us) {
+            // Wedged outside the watchdog's reach, e.g. a corrupted handler
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            break;
+        }
+
+        usleep(200);
+        waited_us += 200;
+    }
+
+    *status_out = status;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return 1;
+    }
+
+    // A clean exit that skipped candidates (e.g. an exit syscall) is a crash too
+    for (uint32_t i = 0; i < count; i++) {
+        if (fs->outcomes[i].signum == FORK_OUTCOME_PENDING) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void record_crash(ForkServer *fs, uint32_t insn, int status)
+{
+    fs->crashes++;
+
+    if (!fs->crash_file) {
+        return;
+    }
+
+    if (WIFSIGNALED(status)) {
+        fprintf(fs->crash_file, "0x%08x signal %d\n", insn, WTERMSIG(status));
+    } else if (WIFEXITED(status)) {
+        fprintf(fs->crash_file, "0x%08x exit %d\n", insn, WEXITSTATUS(status));
+    } else {
+        fprintf(fs->crash_file, "0x%08x status %d\n", insn, status);
+    }
+}
+
+static int screen_batch(ForkServer *fs, uint32_t start, uint32_t count)
+{
+    int status = 0;
+    int ret = run_batch(fs, start, count, &status);
+
+    if (ret < 0) {
+        return -1;
+    }
+
+    if (ret == 0) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (fs->outcomes[i].signum != FORK_OUTCOME_SKIPPED) {
+                fs->record_fn(&fs->outcomes[i], fs->arg);
+            }
+        }
+        return 0;
+    }
+
+    if (count == 1) {
+        record_crash(fs, start, status);
+        return 0;
+    }
+
+    // Bisect: only the half holding the culprit keeps crashing
+    uint32_t half = count / 2;
+    if (screen_batch(fs, start, half) != 0) {
+        return -1;
+    }
+    return screen_batch(fs, start + half, count - half);
+}
+
+int fork_server_screen(ForkServer *fs, uint32_t start, uint32_t end)
+{
+    if (!fs || !fs->outcomes || end <= start) {
+        return -1;
+    }
+
+    for (uint64_t batch = start; batch < end; batch += fs->batch_size) {
+        uint64_t remaining = (uint64_t)end - batch;
+        uint32_t count = (remaining < fs->batch_size) ? (uint32_t)remaining : fs->batch_size;
+
+        if (screen_batch(fs, (uint32_t)batch, count) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
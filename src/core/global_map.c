@@ -0,0 +1,100 @@
+#include "global_map.h"
+
+static off_t plane_offset(int plane)
+{
+    return (off_t)GLOBAL_MAP_HEADER_BYTES + (off_t)plane * (off_t)GLOBAL_MAP_PLANE_BYTES;
+}
+
+int global_map_open(GlobalMap *gm, const char *path)
+{
+    gm->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (gm->fd < 0) {
+        fprintf(stderr, "failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    // Workers may start together, only one writes the header
+    if (flock(gm->fd, LOCK_EX) != 0) {
+        perror("flock global map failed");
+        close(gm->fd);
+        return -1;
+    }
+
+    GlobalMapHeader hdr;
+    ssize_t n = pread(gm->fd, &hdr, sizeof(hdr), 0);
+
+    if (n == 0) {
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, GLOBAL_MAP_MAGIC, sizeof(hdr.magic));
+        hdr.header_bytes = GLOBAL_MAP_HEADER_BYTES;
+        hdr.planes       = GLOBAL_PLANES;
+        hdr.plane_bytes  = GLOBAL_MAP_PLANE_BYTES;
+
+        // ftruncate leaves a hole, no plane page is allocated yet
+        if (pwrite(gm->fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+            ftruncate(gm->fd, plane_offset(GLOBAL_PLANES)) != 0) {
+            fprintf(stderr, "failed to initialise %s: %s\n", path, strerror(errno));
+            flock(gm->fd, LOCK_UN);
+            close(gm->fd);
+            return -1;
+        }
+    } else if (n != (ssize_t)sizeof(hdr) ||
+               memcmp(hdr.magic, GLOBAL_MAP_MAGIC, sizeof(hdr.magic)) != 0 ||
+               hdr.header_bytes != GLOBAL_MAP_HEADER_BYTES ||
+               hdr.planes != GLOBAL_PLANES || hdr.plane_bytes != GLOBAL_MAP_PLANE_BYTES) {
+        fprintf(stderr, "%s is not a global result map\n", path);
+        flock(gm->fd, LOCK_UN);
+        close(gm->fd);
+        return -1;
+    }
+
+    flock(gm->fd, LOCK_UN);
+    return 0;
+}
+
+void global_map_close(GlobalMap *gm)
+{
+    if (gm->fd >= 0) {
+        close(gm->fd);
+        gm->fd = -1;
+    }
+}
+
+int global_map_window_open(GlobalMapWindow *w, const GlobalMap *gm, uint32_t start, uint32_t end)
+{
+    if (end <= start) {
+        return -1;
+    }
+
+    long page = sysconf(_SC_PAGESIZE);
+    uint64_t lo = ((uint64_t)start / 8) & ~(uint64_t)(page - 1);
+    uint64_t hi = ((uint64_t)end + 7) / 8;
+    hi = (hi + page - 1) & ~(uint64_t)(page - 1);
+
+    memset(w, 0, sizeof(*w));
+    w->first_bit = lo * 8;
+    w->len       = (size_t)(hi - lo);
+
+    for (int p = 0; p < GLOBAL_PLANES; p++) {
+        void *addr = mmap(NULL, w->len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          gm->fd, plane_offset(p) + (off_t)lo);
+        if (addr == MAP_FAILED) {
+            perror("mmap global map window failed");
+            global_map_window_close(w);
+            return -1;
+        }
+        w->plane[p] = (uint64_t *)addr;
+    }
+
+    return 0;
+}
+
+void global_map_window_close(GlobalMapWindow *w)
+{
+    for (int p = 0; p < GLOBAL_PLANES; p++) {
+        if (w->plane[p]) {
+            munmap(w->plane[p], w->len);
+            w->plane[p] = NULL;
+        }
+    }
+}
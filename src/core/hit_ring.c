@@ -0,0 +1,171 @@
+#include "hit_ring.h"
+
+static size_t ring_bytes(uint32_t slots)
+{
+    return sizeof(HitRingHeader) + (size_t)slots * sizeof(FaultRecord);
+}
+
+static int ring_map(HitRing *r, int fd, size_t bytes)
+{
+    void *addr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        perror("mmap hit ring failed");
+        return -1;
+    }
+
+    r->hdr       = (HitRingHeader *)addr;
+    r->slots     = (FaultRecord *)((uint8_t *)addr + sizeof(HitRingHeader));
+    r->map_bytes = bytes;
+    return 0;
+}
+
+int hit_ring_create(HitRing *r, const char *path, uint32_t slots, int thumb, int file_number)
+{
+    memset(r, 0, sizeof(*r));
+
+    if (slots == 0 || (slots & (slots - 1)) != 0) {
+        fprintf(stderr, "hit ring size %u is not a power of two\n", slots);
+        return -1;
+    }
+
+    /*
+     * A consumer of an earlier run may still have the old file mapped;
+     * truncating it under that mapping would SIGBUS it. Unlink and create
+     * a fresh inode instead, the old one goes away with its last mapping.
+     */
+    if (unlink(path) != 0 && errno != ENOENT) {
+        fprintf(stderr, "failed to remove %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "failed to create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    size_t bytes = ring_bytes(slots);
+    if (ftruncate(fd, (off_t)bytes) != 0 || ring_map(r, fd, bytes) != 0) {
+        fprintf(stderr, "failed to size %s\n", path);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    r->hdr->slots       = slots;
+    r->hdr->thumb       = (uint32_t)thumb;
+    r->hdr->file_number = file_number;
+
+    // A consumer polling the file only trusts it once the magic is there
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(r->hdr->magic, HIT_RING_MAGIC, sizeof(r->hdr->magic));
+    return 0;
+}
+
+int hit_ring_attach(HitRing *r, const char *path, uint32_t wait_ms)
+{
+    memset(r, 0, sizeof(*r));
+    r->consumer = 1;
+
+    HitRingHeader hdr;
+    int fd = -1;
+
+    for (uint32_t waited = 0;; waited += 100) {
+        if (fd < 0) {
+            fd = open(path, O_RDWR);
+        }
+        if (fd >= 0 && pread(fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr) &&
+            memcmp(hdr.magic, HIT_RING_MAGIC, sizeof(hdr.magic)) == 0) {
+            break;
+        }
+        if (waited >= wait_ms) {
+            fprintf(stderr, "%s is not a hit ring (yet)\n", path);
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+        usleep(100000);
+    }
+
+    if (hdr.slots == 0 || (hdr.slots & (hdr.slots - 1)) != 0 || ring_map(r, fd, ring_bytes(hdr.slots)) != 0) {
+        fprintf(stderr, "%s has a broken header\n", path);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    uint32_t expected = 0;
+    if (!__atomic_compare_exchange_n(&r->hdr->consumer_attached, &expected, 1, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        fprintf(stderr, "%s already has a consumer\n", path);
+        munmap(r->hdr, r->map_bytes);
+        r->hdr = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void hit_ring_close(HitRing *r)
+{
+    if (!r->hdr) {
+        return;
+    }
+
+    if (r->consumer) {
+        __atomic_store_n(&r->hdr->consumer_attached, 0, __ATOMIC_RELEASE);
+    } else {
+        __atomic_store_n(&r->hdr->producer_done, 1, __ATOMIC_RELEASE);
+    }
+
+    munmap(r->hdr, r->map_bytes);
+    r->hdr = NULL;
+}
+
+int hit_ring_push(HitRing *r, const FaultRecord *rec)
+{
+    HitRingHeader *h = r->hdr;
+    uint32_t head = h->head;               // only this side writes it
+    uint32_t tail = __atomic_load_n(&h->tail, __ATOMIC_ACQUIRE);
+    uint64_t waited_ns = 0;
+
+    while (head - tail == h->slots) {
+        // A consumer that stopped draining only costs the first wait
+        if (!__atomic_load_n(&h->consumer_attached, __ATOMIC_ACQUIRE) ||
+            (r->stalled && tail == r->stalled_tail) ||
+            waited_ns >= HIT_RING_STALL_MS * 1000000ull) {
+            r->stalled      = 1;
+            r->stalled_tail = tail;
+            __atomic_fetch_add(&h->dropped, 1, __ATOMIC_RELAXED);
+            return 1;
+        }
+
+        struct timespec nap = { 0, HIT_RING_WAIT_NS };
+        nanosleep(&nap, NULL);
+        waited_ns += HIT_RING_WAIT_NS;
+        tail = __atomic_load_n(&h->tail, __ATOMIC_ACQUIRE);
+    }
+
+    r->stalled = 0;
+    r->slots[head & (h->slots - 1)] = *rec;
+    __atomic_store_n(&h->head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int hit_ring_pop(HitRing *r, FaultRecord *rec)
+{
+    HitRingHeader *h = r->hdr;
+    uint32_t tail = h->tail;               // only this side writes it
+    uint32_t head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+        // done is published after the last push, so look at head again
+        if (__atomic_load_n(&h->producer_done, __ATOMIC_ACQUIRE) &&
+            __atomic_load_n(&h->head, __ATOMIC_ACQUIRE) == tail) {
+            return -1;
+        }
+        return 0;
+    }
+
+    *rec = r->slots[tail & (h->slots - 1)];
+    __atomic_store_n(&h->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
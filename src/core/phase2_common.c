@@ -0,0 +1,117 @@
+#include "phase2_common.h"
+
+const char *const phase2_reg_names[PHASE2_GPRS] = {
+    "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+    "r8", "r9", "r10", "r11", "r12",
+};
+
+void phase2_init_signal_handlers(void)
+{
+    init_signal_handler(signal_handler, SIGILL,    SA_NONE);
+    init_signal_handler(signal_handler, SIGSEGV,   SA_NONE);
+    init_signal_handler(signal_handler, SIGTRAP,   SA_NONE);
+    init_signal_handler(signal_handler, SIGBUS,    SA_NONE);
+    init_signal_handler(signal_handler, SIGSYS,    SA_NONE);
+
+    init_signal_handler(signal_handler, SIGRTMIN,  SA_NODEFER);
+    init_signal_handler(signal_handler, SIGVTALRM, SA_NODEFER);
+}
+
+int phase2_ctx_init(SandboxContext *ctx, const SandboxTemplate *tpl)
+{
+    if (sandbox_ctx_init_template(ctx, tpl) != 0) {
+        fprintf(stderr, "sandbox_ctx_init failed\n");
+        return -1;
+    }
+    if (sandbox_ctx_seccomp(ctx) != 0) {
+        fprintf(stderr, "no seccomp filter, candidates make real system calls\n");
+    }
+    return 0;
+}
+
+const char *phase2_outcome_name(int signum)
+{
+    switch (signum) {
+    case 0:       return "exec";
+    case SIGILL:  return "sigill";
+    case SIGSEGV: return "sigsegv";
+    case SIGBUS:  return "sigbus";
+    case SIGTRAP: return "sigtrap";
+    case SIGSYS:  return "sigsys";
+    case SIGALRM: return "timeout";
+    default:      return "signal";
+    }
+}
+
+void phase2_run_reg(SandboxContext *ctx, RegisterStates *states, uint32_t insn)
+{
+    uint8_t insn_bytes[4];
+    size_t buf_len = fill_insn_buffer(insn_bytes, sizeof(insn_bytes), insn);
+
+    memset(states, 0, 2 * sizeof(RegisterStates));
+    sandbox_ctx_execute_reg(ctx, insn_bytes, buf_len, states);
+}
+
+void phase2_run_pmu(SandboxContext *ctx, RegisterStates *states, PmuCounter *pmu,
+                    PmuResult *result, uint32_t insn)
+{
+    uint8_t insn_bytes[4];
+    size_t buf_len = fill_insn_buffer(insn_bytes, sizeof(insn_bytes), insn);
+
+    memset(states, 0, 2 * sizeof(RegisterStates));
+    sandbox_ctx_execute_pmu(ctx, insn_bytes, buf_len, states, pmu, result);
+}
+
+void phase2_run_ext(SandboxContext *ctx, ExtRegisterStates *states, uint32_t insn)
+{
+    uint8_t insn_bytes[4];
+    size_t buf_len = fill_insn_buffer(insn_bytes, sizeof(insn_bytes), insn);
+
+    memset(states, 0, 2 * sizeof(ExtRegisterStates));
+    sandbox_ctx_execute_ext(ctx, insn_bytes, buf_len, states);
+}
+
+int phase2_calibrate(SandboxContext *ctx, PmuCounter *pmu, PmuResult *baseline,
+                     uint32_t *pc_delta)
+{
+    RegisterStates states[2];
+    PmuResult result;
+    int runs = pmu ? PHASE2_BASELINE_RUNS : 1;
+
+    if (pmu) {
+        baseline->ld_count = baseline->st_count = UINT64_MAX;
+    }
+
+    for (int i = 0; i < runs; i++) {
+        if (pmu) {
+            phase2_run_pmu(ctx, states, pmu, &result, PHASE2_NOP_A32);
+        } else {
+            phase2_run_reg(ctx, states, PHASE2_NOP_A32);
+        }
+        if (ctx->last_insn_signum != 0) {
+            fprintf(stderr, "calibration nop raised signal %d\n", ctx->last_insn_signum);
+            return -1;
+        }
+        if (pmu) {
+            if (result.ld_count < baseline->ld_count) baseline->ld_count = result.ld_count;
+            if (result.st_count < baseline->st_count) baseline->st_count = result.st_count;
+        }
+    }
+
+    *pc_delta = states[1].pc - states[0].pc;
+    return 0;
+}
+
+int phase2_calibrate_ext(SandboxContext *ctx, uint32_t *pc_delta)
+{
+    ExtRegisterStates states[2];
+
+    phase2_run_ext(ctx, states, PHASE2_NOP_A32);
+    if (ctx->last_insn_signum != 0) {
+        fprintf(stderr, "calibration nop raised signal %d\n", ctx->last_insn_signum);
+        return -1;
+    }
+
+    *pc_delta = states[1].core.pc - states[0].core.pc;
+    return 0;
+}
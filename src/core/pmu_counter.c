@@ -22,13 +22,13 @@ int init_memory_monitor(PmuCounter *pmu) {
     attr.config = 0x0006;
     pmu->ld_retired_fd = perf_event_open(&attr, tid, cpu, -1, 0);
     if (pmu->ld_retired_fd == -1) {
-        printf("LD_RETIRED failed: %s\n", strerror(errno));
+        fprintf(stderr, "LD_RETIRED failed: %s\n", strerror(errno));
     }
 
     attr.config = 0x0007;
     pmu->st_retired_fd = perf_event_open(&attr, tid, cpu, -1, 0);
     if (pmu->st_retired_fd == -1) {
-        printf("ST_RETIRED failed: %s\n", strerror(errno));
+        fprintf(stderr, "ST_RETIRED failed: %s\n", strerror(errno));
     }
     
     return 0;
@@ -69,4 +69,120 @@ void execute_insn_page_pmu(uint8_t *insn_bytes, size_t insn_length, RegisterStat
         n = read(pmu->ld_retired_fd, &result->ld_count, sizeof(uint64_t));
         n = read(pmu->st_retired_fd, &result->st_count, sizeof(uint64_t));
     }
-}
\ No newline at end of file
+}
+
+void sandbox_ctx_execute_pmu(struct SandboxContext *sctx, uint8_t *insn_bytes, size_t insn_length,
+                             RegisterStates *states, PmuCounter *pmu, PmuResult *result) {
+    PmuExecContext ctx = {
+        .states = states,
+        .pmu    = pmu,
+    };
+    sandbox_ctx_execute(sctx, insn_bytes, insn_length, &ctx, pre_pmu, exec_pmu, post_pmu);
+
+    // post_pmu is skipped when the candidate escapes through the signal handler
+    if (sctx->last_insn_signum != 0) {
+        post_pmu(&ctx);
+    }
+
+    if (result) {
+        if (read(pmu->ld_retired_fd, &result->ld_count, sizeof(uint64_t)) != sizeof(uint64_t)) {
+            result->ld_count = 0;
+        }
+        if (read(pmu->st_retired_fd, &result->st_count, sizeof(uint64_t)) != sizeof(uint64_t)) {
+            result->st_count = 0;
+        }
+    }
+}
+
+int pmu_group_open(PmuGroup *g) {
+    struct perf_event_attr attr = {0};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.disabled = 1;
+    attr.pinned = 1;
+    g->cycles_fd = perf_event_open(&attr, 0, -1, -1, 0);
+    if (g->cycles_fd == -1) {
+        fprintf(stderr, "CPU_CYCLES failed: %s\n", strerror(errno));
+        g->insns_fd = -1;
+        return -1;
+    }
+
+    // Members follow the leader's enable state
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 0;
+    attr.pinned = 0;
+    g->insns_fd = perf_event_open(&attr, 0, -1, g->cycles_fd, 0);
+    if (g->insns_fd == -1) {
+        fprintf(stderr, "INST_RETIRED failed: %s\n", strerror(errno));
+        close(g->cycles_fd);
+        g->cycles_fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+void pmu_group_close(PmuGroup *g) {
+    if (g->insns_fd >= 0) close(g->insns_fd);
+    if (g->cycles_fd >= 0) close(g->cycles_fd);
+    g->insns_fd = g->cycles_fd = -1;
+}
+
+typedef struct {
+    PmuGroup       *group;
+    struct timespec t0, t1;
+} PmuGroupExecContext;
+
+static void pre_group(void *ctx) {
+    PmuGroupExecContext *c = (PmuGroupExecContext *)ctx;
+    if (c->group->cycles_fd >= 0) {
+        ioctl(c->group->cycles_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(c->group->cycles_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &c->t0);
+}
+
+static void post_group(void *ctx) {
+    PmuGroupExecContext *c = (PmuGroupExecContext *)ctx;
+    clock_gettime(CLOCK_MONOTONIC, &c->t1);
+    if (c->group->cycles_fd >= 0) {
+        ioctl(c->group->cycles_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+static void exec_plain(void *addr, void *ctx) {
+    (void)ctx;
+    void (*exec_page)(void) = (void (*)(void))addr;
+    exec_page();
+}
+
+void sandbox_ctx_execute_group(struct SandboxContext *sctx, uint8_t *insn_bytes, size_t insn_length,
+                               PmuGroup *g, PmuGroupResult *result) {
+    PmuGroupExecContext ctx = { .group = g };
+
+    memset(result, 0, sizeof(*result));
+    sandbox_ctx_execute(sctx, insn_bytes, insn_length, &ctx, pre_group, exec_plain, post_group);
+
+    if (sctx->last_insn_signum != 0) {
+        if (g->cycles_fd >= 0) {
+            ioctl(g->cycles_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+        return;
+    }
+
+    result->ns = (uint64_t)(ctx.t1.tv_sec - ctx.t0.tv_sec) * 1000000000ull
+               + (uint64_t)(ctx.t1.tv_nsec - ctx.t0.tv_nsec);
+
+    // PERF_FORMAT_GROUP: { nr, value[nr] } in the order the events were opened
+    uint64_t buf[3];
+    if (g->cycles_fd >= 0 &&
+        read(g->cycles_fd, buf, sizeof(buf)) == sizeof(buf) && buf[0] == 2) {
+        result->cycles = buf[1];
+        result->insns  = buf[2];
+    }
+}
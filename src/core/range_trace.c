@@ -0,0 +1,154 @@
+#include "range_trace.h"
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Counts the calling thread only; kernel time first, most of it is signal delivery
+static int open_thread_cycles(uint32_t *scope)
+{
+    struct perf_event_attr attr = {0};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_hv = 1;
+
+    int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd >= 0) {
+        *scope = TRACE_CYCLES_KERNEL;
+        return fd;
+    }
+
+    attr.exclude_kernel = 1;
+    fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    *scope = (fd >= 0) ? TRACE_CYCLES_USER : TRACE_CYCLES_NONE;
+    return fd;
+}
+
+static uint64_t read_cycles(int fd)
+{
+    uint64_t value = 0;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) {
+        return 0;
+    }
+    return value;
+}
+
+int range_trace_open(RangeTraceFile *tf, const char *path, int file_number)
+{
+    memset(tf, 0, sizeof(*tf));
+
+    tf->file = fopen(path, "wb");
+    if (!tf->file) {
+        fprintf(stderr, "failed to create %s\n", path);
+        return -1;
+    }
+
+    tf->file_number  = file_number;
+    tf->cycles_scope = TRACE_CYCLES_KERNEL;
+
+    // header：[file_number][record_count][cycles_scope]，written back on close
+    if (fwrite(&tf->file_number, sizeof(int), 1, tf->file) != 1 ||
+        fwrite(&tf->record_count, sizeof(uint32_t), 1, tf->file) != 1 ||
+        fwrite(&tf->cycles_scope, sizeof(uint32_t), 1, tf->file) != 1) {
+        fclose(tf->file);
+        tf->file = NULL;
+        return -1;
+    }
+
+    pthread_mutex_init(&tf->lock, NULL);
+    return 0;
+}
+
+int range_trace_close(RangeTraceFile *tf)
+{
+    if (!tf || !tf->file) return -1;
+
+    int ret = 0;
+    if (fseek(tf->file, sizeof(int), SEEK_SET) != 0 ||
+        fwrite(&tf->record_count, sizeof(uint32_t), 1, tf->file) != 1 ||
+        fwrite(&tf->cycles_scope, sizeof(uint32_t), 1, tf->file) != 1) {
+        ret = -1;
+    }
+
+    if (fclose(tf->file) != 0) {
+        ret = -1;
+    }
+    tf->file = NULL;
+    pthread_mutex_destroy(&tf->lock);
+    return ret;
+}
+
+void range_trace_init(RangeTrace *t, RangeTraceFile *out, int thread)
+{
+    uint32_t scope;
+
+    t->out       = out;
+    t->count     = 0;
+    t->cycles_fd = open_thread_cycles(&scope);
+    memset(&t->cur, 0, sizeof(t->cur));
+    t->cur.thread = (uint16_t)thread;
+
+    pthread_mutex_lock(&out->lock);
+    if (scope < out->cycles_scope) {
+        out->cycles_scope = scope;
+    }
+    pthread_mutex_unlock(&out->lock);
+}
+
+void range_trace_destroy(RangeTrace *t)
+{
+    if (t->cycles_fd >= 0) {
+        close(t->cycles_fd);
+    }
+    t->cycles_fd = -1;
+}
+
+void range_trace_begin(RangeTrace *t, uint32_t start, uint32_t end)
+{
+    uint16_t thread = t->cur.thread;
+
+    memset(&t->cur, 0, sizeof(t->cur));
+    t->cur.thread   = thread;
+    t->cur.start    = start;
+    t->cur.end      = end;
+    t->cycles_begin = read_cycles(t->cycles_fd);
+    t->cur.begin_ns = monotonic_ns();
+}
+
+int range_trace_end(RangeTrace *t)
+{
+    t->cur.wall_ns = monotonic_ns() - t->cur.begin_ns;
+    if (t->cycles_fd >= 0) {
+        t->cur.cycles = read_cycles(t->cycles_fd) - t->cycles_begin;
+    }
+    t->cur.core = (int16_t)sched_getcpu();
+
+    t->records[t->count++] = t->cur;
+    if (t->count == RANGE_TRACE_BUFFER) {
+        return range_trace_flush(t);
+    }
+    return 0;
+}
+
+int range_trace_flush(RangeTrace *t)
+{
+    if (!t || !t->out || t->count == 0) return 0;
+
+    RangeTraceFile *tf = t->out;
+    int ret = 0;
+
+    pthread_mutex_lock(&tf->lock);
+    if (fwrite(t->records, sizeof(RangeTraceRecord), t->count, tf->file) != t->count) {
+        ret = -1;
+    } else {
+        tf->record_count += t->count;
+    }
+    pthread_mutex_unlock(&tf->lock);
+
+    t->count = 0;
+    return ret;
+}
@@ -0,0 +1,242 @@
+#include "rescreen.h"
+#include "stability.h"
+
+// Crashes every load/store/branch family produces with zeroed registers
+static int crash_is_ordinary(int signum)
+{
+    return signum == SIGSEGV || signum == SIGBUS;
+}
+
+int prev_results_load(PrevResults *pr, const char *dir, int file_number)
+{
+    if (!pr || !dir) return -1;
+
+    memset(pr, 0, sizeof(*pr));
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/res%d_complete.bin", dir, file_number);
+    if (bitmap_file_load(&pr->exec, path) != 0) {
+        fprintf(stderr, "[res%d] no usable previous result %s\n", file_number, path);
+        return -1;
+    }
+
+    // Only the header is guaranteed; a missing file means no timeouts
+    snprintf(path, sizeof(path), "%s/res%d_timeout.bin", dir, file_number);
+    if (bitmap_file_load(&pr->timeout, path) != 0 && access(path, F_OK) == 0) {
+        prev_results_free(pr);
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "%s/res%d_faults.bin", dir, file_number);
+    if (fault_log_load(path, &pr->faults, &pr->fault_count) == 0) {
+        pr->has_faults = 1;
+    } else if (access(path, F_OK) == 0) {
+        prev_results_free(pr);
+        return -1;
+    } else {
+        fprintf(stderr, "[res%d] %s missing, crashes are treated like SIGILL\n",
+                file_number, path);
+    }
+
+    // Only there after a stability pass (worker -s)
+    snprintf(path, sizeof(path), "%s/res%d_stability.bin", dir, file_number);
+    if (stability_load_unstable(path, &pr->unstable, &pr->unstable_count) != 0 &&
+        access(path, F_OK) == 0) {
+        prev_results_free(pr);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int cmp_rescreen_range(const void *a, const void *b)
+{
+    const RescreenRange *ra = (const RescreenRange *)a;
+    const RescreenRange *rb = (const RescreenRange *)b;
+    return (ra->start > rb->start) - (ra->start < rb->start);
+}
+
+// Same "[start, end]" lines as the range files, decimal or 0x-hex
+int prev_results_load_changed(PrevResults *pr, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "failed to open %s\n", path);
+        return -1;
+    }
+
+    char line[256];
+    size_t capacity = 0;
+    uint64_t start, end;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, " [ %" SCNi64 " , %" SCNi64 " ]", &start, &end) != 2 ||
+            end <= start || start > UINT32_MAX) {
+            continue;
+        }
+
+        if (pr->changed_count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            RescreenRange *grown = realloc(pr->changed, capacity * sizeof(RescreenRange));
+            if (!grown) {
+                perror("realloc changed ranges failed");
+                fclose(f);
+                return -1;
+            }
+            pr->changed = grown;
+        }
+
+        pr->changed[pr->changed_count].start = (uint32_t)start;
+        pr->changed[pr->changed_count].end   = (end > UINT32_MAX) ? UINT32_MAX : (uint32_t)end;
+        pr->changed_count++;
+    }
+
+    fclose(f);
+    qsort(pr->changed, pr->changed_count, sizeof(RescreenRange), cmp_rescreen_range);
+    return 0;
+}
+
+void prev_results_free(PrevResults *pr)
+{
+    if (!pr) return;
+
+    bitmap_file_free(&pr->exec);
+    bitmap_file_free(&pr->timeout);
+    free(pr->faults);
+    free(pr->unstable);
+    free(pr->changed);
+    memset(pr, 0, sizeof(*pr));
+}
+
+static const FaultRecord *find_fault(const FaultRecord *faults, uint32_t count, uint32_t insn)
+{
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (faults[mid].insn < insn) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return &faults[lo];                    // first record >= insn, may be the end
+}
+
+int rescreen_plan_init(RescreenPlan *plan, const PrevResults *pr,
+                       uint32_t start, uint32_t end, unsigned int *seed)
+{
+    if (!plan || !pr || end <= start) return -1;
+
+    memset(plan, 0, sizeof(*plan));
+
+    uint32_t bits  = end - start;
+    size_t   words = BITMAP_WORDS(bits);
+
+    uint64_t *rerun   = (uint64_t *)calloc(words, sizeof(uint64_t));
+    uint64_t *sampled = (uint64_t *)calloc(words, sizeof(uint64_t));
+    uint64_t *covered = (uint64_t *)calloc(words, sizeof(uint64_t));
+    if (!rerun || !sampled || !covered) {
+        perror("calloc rescreen plan failed");
+        free(rerun);
+        free(sampled);
+        free(covered);
+        return -1;
+    }
+
+    plan->start   = start;
+    plan->bits    = bits;
+    plan->rerun   = rerun;
+    plan->sampled = sampled;
+
+    // Executed or timed out before, or never screened at all
+    bitmap_file_extract(&pr->exec, start, end, rerun, covered);
+    bitmap_file_extract(&pr->timeout, start, end, rerun, NULL);
+
+    for (size_t i = 0; i < words; i++) {
+        rerun[i] |= ~covered[i];
+    }
+    if (bits % BITMAP_WORD_BITS) {
+        rerun[words - 1] &= (1ULL << (bits % BITMAP_WORD_BITS)) - 1;
+    }
+    free(covered);
+
+    // Unusual crashes
+    if (pr->has_faults) {
+        const FaultRecord *rec = find_fault(pr->faults, pr->fault_count, start);
+        const FaultRecord *last = pr->faults + pr->fault_count;
+
+        plan->faults = rec;
+        for (; rec < last && rec->insn < end; rec++) {
+            if (!crash_is_ordinary(rec->signum)) {
+                bitmap_set(rerun, rec->insn - start);
+            }
+            plan->fault_count++;
+        }
+    }
+
+    // Flaky or operand-dependent in the stability pass
+    uint32_t lo = 0, hi = pr->unstable_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (pr->unstable[mid] < start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (; lo < pr->unstable_count && pr->unstable[lo] < end; lo++) {
+        bitmap_set(rerun, pr->unstable[lo] - start);
+    }
+
+    // Flagged as changed
+    for (size_t i = 0; i < pr->changed_count && pr->changed[i].start < end; i++) {
+        const RescreenRange *c = &pr->changed[i];
+        if (c->end <= start) {
+            continue;
+        }
+        uint32_t from = (c->start > start) ? c->start : start;
+        uint32_t to   = (c->end < end) ? c->end : end;
+        bitmap_set_bits(rerun, from - start, to - from);
+    }
+
+    // Samples among the stable rest, on average one in sample_every
+    if (pr->sample_every > 0) {
+        size_t off = (size_t)(rand_r(seed) % pr->sample_every);
+
+        for (;;) {
+            off = bitmap_next_clear(rerun, bits, off);
+            if (off >= bits) {
+                break;
+            }
+            bitmap_set(sampled, off);
+            off += 1 + (size_t)(rand_r(seed) % (2 * pr->sample_every));
+        }
+        bitmap_or(rerun, rerun, sampled, words);
+    }
+
+    return 0;
+}
+
+void rescreen_plan_destroy(RescreenPlan *plan)
+{
+    if (!plan) return;
+
+    free(plan->rerun);
+    free(plan->sampled);
+    memset(plan, 0, sizeof(*plan));
+}
+
+int rescreen_outcome_changed(const RescreenPlan *plan, const PrevResults *pr,
+                             uint32_t insn, int signum)
+{
+    if (!pr->has_faults) {
+        // Only SIGILL versus "some crash" can no longer be told apart
+        return !(signum == SIGILL || crash_is_ordinary(signum));
+    }
+
+    const FaultRecord *rec  = find_fault(plan->faults, plan->fault_count, insn);
+    const FaultRecord *last = plan->faults + plan->fault_count;
+    int prev_signum = (rec < last && rec->insn == insn) ? rec->signum : SIGILL;
+
+    return signum != prev_signum;
+}
@@ -1,18 +1,20 @@
 #include "sandbox.h"
+#include <stddef.h>
+#include <sys/prctl.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
 
 
 void *insn_region = NULL;                  // [guard][code][guard]
 void *insn_page   = NULL;                  // Executable Page
 
 volatile sig_atomic_t last_insn_signum  = 0;
-volatile sig_atomic_t executing_insn    = 0;
 volatile sig_atomic_t timeout_occurred  = 0;
 
 uint32_t insn_offset = 0;
 uint32_t mask        = 0x1111;
 
-sigjmp_buf escape_env;
-
 timer_t watchdog_timer;
 
 uint8_t sig_stack_array[MY_SIGSTKSZ];
@@ -22,31 +24,69 @@ stack_t sig_stack = {
     .ss_sp   = sig_stack_array,
 };
 
+SandboxContext sandbox_default_ctx;
+
+// Context whose candidate is running on this thread, used by signal_handler
+static _Thread_local SandboxContext *current_ctx = NULL;
+
+#ifdef SANDBOX_STATS
+SandboxStats sandbox_stats;
+#endif
+
 void signal_handler(int sig_num, siginfo_t *sig_info, void *uc_ptr)
 {
-    // Suppress unused warning
-    (void)sig_info;
-
     ucontext_t* uc = (ucontext_t*) uc_ptr;
+    SandboxContext *ctx = current_ctx;
 
-    last_insn_signum = sig_num;
-
+    SANDBOX_STAT_INC(signals);
 
-    if (executing_insn == 0) {
+    if (ctx == NULL || ctx->executing_insn == 0) {
         // Something other than a hidden insn execution raised the signal,
         // so quit
         fprintf(stderr, "%s\n", strsignal(sig_num));
         exit(1);
     }
 
+    ctx->last_insn_signum = sig_num;
+    ctx->fault_code = sig_info->si_code;
+    ctx->fault_addr = (uint32_t)(uintptr_t)sig_info->si_addr;
+    ctx->fault_pc   = (uint32_t)uc->uc_mcontext.arm_pc;
+
+    uint32_t page_off = ctx->fault_pc - (uint32_t)(uintptr_t)ctx->insn_page;
+    if ((sig_num == SIGILL || sig_num == SIGTRAP) &&
+        page_off >= ctx->fill_start && page_off < PAGE_SIZE) {
+        ctx->landed = 1;
+    }
+
+    /*
+     * The boilerplate after the candidate slot never faults by itself:
+     * the candidate fell through but left a frame that cannot be trusted
+     * (TPIDRURW or the saved registers), so the signal is not its own.
+     * A seccomp SIGSYS reports the pc past the svc, so it is excluded.
+     */
+    if (sig_num != SIGRTMIN && sig_num != SIGSYS &&
+        page_off >= ctx->insn_offset * 4 + 4 && page_off < ctx->fill_start) {
+        ctx->state_lost = 1;
+    }
+
+    // Seccomp trap: the syscall number stands in for the address
+    if (sig_num == SIGSYS) {
+        ctx->fault_addr = (uint32_t)sig_info->si_syscall;
+    }
+
+    // The watchdog fires SIGRTMIN at this thread
+    if (sig_num == SIGRTMIN) {
+        ctx->timeout_occurred = 1;
+    }
+
     // Jump to the next instruction (i.e. skip the illegal insn)
     // uintptr_t insn_skip = (uintptr_t)(insn_page) + (insn_offset+1)*4;
 
     // //aarch32
     // uc->uc_mcontext.arm_pc = insn_skip;
 
-    (void)uc; 
-    siglongjmp(escape_env, sig_num);
+    SANDBOX_STAT_INC(sigmask_calls);
+    siglongjmp(ctx->escape_env, sig_num);
 }
 
 void init_signal_handler(void (*handler)(int, siginfo_t*, void*), int signum, int flags)
@@ -65,94 +105,377 @@ void init_signal_handler(void (*handler)(int, siginfo_t*, void*), int signum, in
     sigaction(signum,  &s, NULL);
 }
 
-int init_insn_page(void)
+static void fill_landing_zone(SandboxContext *ctx)
+{
+    uint32_t *words = (uint32_t *)ctx->insn_page;
+
+    for (uint32_t i = ctx->fill_start / 4; i < PAGE_SIZE / 4; i++) {
+        if (ctx->thumb) {
+            // Little endian: the lower halfword comes first
+            words[i] = T32_UDF(2 * i) | (T32_UDF(2 * i + 1) << 16);
+        } else {
+            words[i] = A32_UDF(i);
+        }
+    }
+}
+
+static int ctx_map_page(SandboxContext *ctx, const SandboxTemplate *tpl)
 {
     // Allocate an executable page / memory region
-    insn_region = mmap(NULL,
-                       PAGE_SIZE * 3,
-                       PROT_NONE,
-                       MAP_PRIVATE | MAP_ANONYMOUS,
-                       -1,
-                       0);
-
-    if (insn_region == MAP_FAILED)
+    ctx->insn_region = mmap(NULL,
+                            PAGE_SIZE * 3,
+                            PROT_NONE,
+                            MAP_PRIVATE | MAP_ANONYMOUS,
+                            -1,
+                            0);
+
+    if (ctx->insn_region == MAP_FAILED) {
+        ctx->insn_region = NULL;
         return 1;
+    }
 
-    insn_page = (uint8_t*)insn_region + PAGE_SIZE;
+    ctx->insn_page = (uint8_t*)ctx->insn_region + PAGE_SIZE;
 
-    if (mprotect(insn_page, PAGE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
-        munmap(insn_region, PAGE_SIZE * 3);
+    if (mprotect(ctx->insn_page, PAGE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
+        munmap(ctx->insn_region, PAGE_SIZE * 3);
+        ctx->insn_region = NULL;
         return 1;
     }
 
-    uint32_t boilerplate_length = (&boilerplate_end - &boilerplate_start) / 4;
+    char *start    = tpl ? tpl->start    : &boilerplate_start;
+    char *end      = tpl ? tpl->end      : &boilerplate_end;
+    char *location = tpl ? tpl->location : &insn_location;
+
+    uint32_t boilerplate_length = (end - start + 3) / 4;
 
     // Load the boilerplate assembly
     uint32_t i;
     for (i = 0; i < boilerplate_length; ++i)
-        ((uint32_t *)insn_page)[i] = ((uint32_t *)&boilerplate_start)[i];
+        ((uint32_t *)ctx->insn_page)[i] = ((uint32_t *)start)[i];
+
+    ctx->insn_offset = (location - start) / 4;
+    ctx->thumb       = tpl ? tpl->thumb : 0;
+    ctx->fill_start  = boilerplate_length * 4;
 
-    insn_offset = (&insn_location - &boilerplate_start) / 4;
+    fill_landing_zone(ctx);
 
-    if (mprotect(insn_page, PAGE_SIZE, PROT_READ | PROT_EXEC) != 0) {
-        munmap(insn_region, PAGE_SIZE * 3);
+    if (mprotect(ctx->insn_page, PAGE_SIZE, PROT_READ | PROT_EXEC) != 0) {
+        munmap(ctx->insn_region, PAGE_SIZE * 3);
+        ctx->insn_region = NULL;
         return 1;
     }
 
     return 0;
 }
 
-void execute_insn_page(uint8_t *insn_bytes, size_t insn_length, void *ctx, 
-                       converge_exec_t pre_exec, 
-                       exec_t exec_cb, 
-                       converge_exec_t post_exec)
+static pid_t gettid_wrapper(void) {
+    return syscall(SYS_gettid);
+}
+
+static int ctx_create_timer(SandboxContext *ctx) {
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGRTMIN; 
+    sev._sigev_un._tid = gettid_wrapper(); 
+    
+    if (timer_create(CLOCK_MONOTONIC, &sev, &ctx->watchdog_timer) != 0) {
+        perror("timer_create failed");
+        return -1;
+    }
+    ctx->has_timer = 1;
+    return 0;
+}
+
+static void ctx_arm_watchdog(SandboxContext *ctx, int us) {
+    struct itimerspec its = {
+        .it_value.tv_sec = 0,
+        .it_value.tv_nsec = us * 1000,
+        .it_interval = {0, 0}
+    };
+    SANDBOX_STAT_INC(timer_calls);
+    timer_settime(ctx->watchdog_timer, 0, &its, NULL);
+}
+
+static void ctx_disarm_watchdog(SandboxContext *ctx) {
+    struct itimerspec its = {{0, 0}, {0, 0}};
+    SANDBOX_STAT_INC(timer_calls);
+    timer_settime(ctx->watchdog_timer, 0, &its, NULL);
+}
+
+int sandbox_ctx_init(SandboxContext *ctx)
+{
+    return sandbox_ctx_init_template(ctx, NULL);
+}
+
+int sandbox_ctx_init_template(SandboxContext *ctx, const SandboxTemplate *tpl)
+{
+    memset(ctx, 0, sizeof(*ctx));
+
+    if (ctx_map_page(ctx, tpl) != 0) {
+        perror("insn_page mmap failed");
+        return -1;
+    }
+
+    if (ctx_create_timer(ctx) != 0) {
+        sandbox_ctx_destroy(ctx);
+        return -1;
+    }
+
+    ctx->sig_stack_mem = malloc(MY_SIGSTKSZ);
+    if (!ctx->sig_stack_mem) {
+        perror("malloc sig_stack failed");
+        sandbox_ctx_destroy(ctx);
+        return -1;
+    }
+
+    ctx->sig_stack.ss_sp    = ctx->sig_stack_mem;
+    ctx->sig_stack.ss_size  = MY_SIGSTKSZ;
+    ctx->sig_stack.ss_flags = 0;
+
+    if (sigaltstack(&ctx->sig_stack, NULL) != 0) {
+        perror("sigaltstack failed");
+        sandbox_ctx_destroy(ctx);
+        return -1;
+    }
+
+    current_ctx = ctx;
+    return 0;
+}
+
+void sandbox_ctx_destroy(SandboxContext *ctx)
+{
+    if (!ctx) return;
+
+    if (current_ctx == ctx) {
+        current_ctx = NULL;
+    }
+
+    if (ctx->has_timer) {
+        timer_delete(ctx->watchdog_timer);
+        ctx->has_timer = 0;
+    }
+
+    if (ctx->sig_stack_mem) {
+        stack_t disable = { .ss_flags = SS_DISABLE };
+        sigaltstack(&disable, NULL);
+        free(ctx->sig_stack_mem);
+        ctx->sig_stack_mem = NULL;
+    }
+
+    if (ctx->insn_region) {
+        munmap(ctx->insn_region, PAGE_SIZE * 3);
+        ctx->insn_region = NULL;
+        ctx->insn_page   = NULL;
+    }
+}
+
+/*
+ * A forked child inherits the insn page and sigaltstack but not the
+ * POSIX timer, so it needs its own watchdog aimed at itself.
+ */
+int sandbox_ctx_after_fork(SandboxContext *ctx)
+{
+    ctx->has_timer = 0;
+    if (ctx_create_timer(ctx) != 0) {
+        return -1;
+    }
+
+    current_ctx = ctx;
+    return 0;
+}
+
+int sandbox_ctx_low_jitter(SandboxContext *ctx)
+{
+    if (mlock(ctx->insn_page, PAGE_SIZE) != 0) {
+        perror("mlock insn_page failed");
+        return -1;
+    }
+
+    // The signal stack is only touched by the first fault otherwise
+    memset(ctx->sig_stack_mem, 0, MY_SIGSTKSZ);
+    if (mlock(ctx->sig_stack_mem, MY_SIGSTKSZ) != 0) {
+        perror("mlock sig_stack failed");
+        return -1;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    ctx->low_jitter     = 1;
+    ctx->lj_execs       = 0;
+    ctx->lj_last_nap_ns = (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+    return 0;
+}
+
+int sandbox_ctx_seccomp(SandboxContext *ctx)
+{
+    uint32_t lo = (uint32_t)(uintptr_t)ctx->insn_page;
+    // After an svc the reported pc is already past it
+    uint32_t hi = lo + PAGE_SIZE;
+
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_ARM, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+        // instruction_pointer is 64 bits wide, the upper half is 0 for us
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, instruction_pointer) + 4),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, instruction_pointer)),
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, lo, 0, 2),
+        BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, hi, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+    };
+    struct sock_fprog prog = {
+        .len    = (unsigned short)(sizeof(filter) / sizeof(filter[0])),
+        .filter = filter,
+    };
+
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0) {
+        perror("prctl PR_SET_NO_NEW_PRIVS failed");
+        return -1;
+    }
+    // Without SECCOMP_FILTER_FLAG_TSYNC: only this thread, and its forks
+    if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog, 0, 0) != 0) {
+        perror("prctl PR_SET_SECCOMP failed");
+        return -1;
+    }
+    return 0;
+}
+
+static void ctx_low_jitter_nap(SandboxContext *ctx)
+{
+    if (++ctx->lj_execs < LOWJITTER_CHECK_EVERY) {
+        return;
+    }
+    ctx->lj_execs = 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+
+    if (now_ns - ctx->lj_last_nap_ns < LOWJITTER_SLICE_NS) {
+        return;
+    }
+
+    // Blocking resets the RLIMIT_RTTIME count and lets per-cpu kthreads run
+    struct timespec nap = { 0, LOWJITTER_NAP_NS };
+    nanosleep(&nap, NULL);
+    ctx->lj_last_nap_ns = now_ns + LOWJITTER_NAP_NS;
+}
+
+void sandbox_ctx_execute(SandboxContext *ctx, uint8_t *insn_bytes, size_t insn_length,
+                         void *cb_ctx,
+                         converge_exec_t pre_exec,
+                         exec_t exec_cb,
+                         converge_exec_t post_exec)
 {
-    if (mprotect(insn_page, PAGE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
+    uint8_t *page = ctx->insn_page;
+
+    SANDBOX_STAT_INC(mprotect_calls);
+    if (mprotect(page, PAGE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
         perror("mprotect RWX failed");
         return;
     }
 
     // Update the first instruction in the instruction buffer
-    memcpy(insn_page + insn_offset * 4, insn_bytes, insn_length);
+    memcpy(page + ctx->insn_offset * 4, insn_bytes, insn_length);
+
+    ctx->last_insn_signum = 0;
+    ctx->timeout_occurred = 0;
+    ctx->fault_code = 0;
+    ctx->fault_addr = 0;
+    ctx->fault_pc   = 0;
+    ctx->landed     = 0;
+    ctx->state_lost = 0;
+    ctx->exec_ns    = 0;
 
-    last_insn_signum = 0;
-    timeout_occurred = 0;
+    // The boilerplates borrow TPIDRURW, a signal skips their restore
+    __asm__ __volatile__("mrc p15, 0, %0, c13, c0, 2" : "=r"(ctx->tpidrurw));
 
     /*
      * Clear insn_page (at the insn to be tested + the msr insn before)
      * in the d- and icache
      * (some instructions might be skipped otherwise.)
      */
-    __builtin___clear_cache(insn_page + (insn_offset - 1) * 4,
-                  insn_page + insn_offset * 4 + insn_length);
+    SANDBOX_STAT_INC(cache_flushes);
+    __builtin___clear_cache((char *)page + (ctx->insn_offset - 1) * 4,
+                  (char *)page + ctx->insn_offset * 4 + insn_length);
 
-    executing_insn = 1;
+    current_ctx = ctx;
+    ctx->executing_insn = 1;
 
+    SANDBOX_STAT_INC(sigmask_calls);
     // Jump to the instruction to be tested (and execute it)
-    if(sigsetjmp(escape_env, 1) == 0) {
-        arm_watchdog_us(200);
+    if(sigsetjmp(ctx->escape_env, 1) == 0) {
+        ctx_arm_watchdog(ctx, ctx->watchdog_us ? (int)ctx->watchdog_us : WATCHDOG_US);
+
+        if(pre_exec) pre_exec(cb_ctx);
 
-        if(pre_exec) pre_exec(ctx);
+        struct timespec t0, t1;
+        if (ctx->time_exec) {
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+        }
+
+        // Bit 0 makes the indirect blx switch to Thumb state
+        exec_cb(ctx->thumb ? page + 1 : page, cb_ctx);
 
-        exec_cb(insn_page, ctx);
+        if (ctx->time_exec) {
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            int64_t ns = (int64_t)(t1.tv_sec - t0.tv_sec) * 1000000000 + (t1.tv_nsec - t0.tv_nsec);
+            ctx->exec_ns = (ns > UINT32_MAX) ? UINT32_MAX : (uint32_t)ns;
+        }
 
-        if(post_exec) post_exec(ctx);
+        if(post_exec) post_exec(cb_ctx);
 
-        disarm_watchdog();
+        ctx_disarm_watchdog(ctx);
     } else {
-        disarm_watchdog();
+        ctx_disarm_watchdog(ctx);
 
-        if (timeout_occurred) {
-            last_insn_signum = SIGALRM;
+        __asm__ __volatile__("mcr p15, 0, %0, c13, c0, 2" : : "r"(ctx->tpidrurw));
+
+        if (ctx->timeout_occurred) {
+            ctx->last_insn_signum = SIGALRM;
         }
     }
     
-    executing_insn = 0;
+    ctx->executing_insn = 0;
 
-    if (mprotect(insn_page, PAGE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
+    SANDBOX_STAT_INC(mprotect_calls);
+    if (mprotect(page, PAGE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
         perror("mprotect restore RWX failed");
     }
 
+    if (ctx->low_jitter) {
+        ctx_low_jitter_nap(ctx);
+    }
+
+}
+
+int init_insn_page(void)
+{
+    if (ctx_map_page(&sandbox_default_ctx, NULL) != 0)
+        return 1;
+
+    insn_region = sandbox_default_ctx.insn_region;
+    insn_page   = sandbox_default_ctx.insn_page;
+    insn_offset = sandbox_default_ctx.insn_offset;
+
+    return 0;
+}
+
+void execute_insn_page(uint8_t *insn_bytes, size_t insn_length, void *ctx, 
+                       converge_exec_t pre_exec, 
+                       exec_t exec_cb, 
+                       converge_exec_t post_exec)
+{
+    sandbox_ctx_execute(&sandbox_default_ctx, insn_bytes, insn_length,
+                        ctx, pre_exec, exec_cb, post_exec);
+
+    last_insn_signum = sandbox_default_ctx.last_insn_signum;
+    timeout_occurred = sandbox_default_ctx.timeout_occurred;
 }
 
 static void exec_std(void *addr, void *ctx) {
@@ -167,6 +490,21 @@ static void exec_reg(void *addr, void *ctx) {
     exec_page(states);
 }
 
+void sandbox_ctx_execute_screen(SandboxContext *ctx, uint8_t *insn_bytes, size_t insn_length) {
+    sandbox_ctx_execute(ctx, insn_bytes, insn_length, NULL, NULL, exec_std, NULL);
+}
+
+void sandbox_ctx_execute_reg(SandboxContext *ctx, uint8_t *insn_bytes, size_t insn_length,
+                             RegisterStates *states) {
+    sandbox_ctx_execute(ctx, insn_bytes, insn_length, states, NULL, exec_reg, NULL);
+}
+
+void sandbox_ctx_execute_ext(SandboxContext *ctx, uint8_t *insn_bytes, size_t insn_length,
+                             ExtRegisterStates *states) {
+    // core is the first member, the template gets the same pointer in r0
+    sandbox_ctx_execute(ctx, insn_bytes, insn_length, states, NULL, exec_reg, NULL);
+}
+
 void execute_insn_page_screen(uint8_t *insn_bytes, size_t insn_length) {
     execute_insn_page(insn_bytes, insn_length, NULL, NULL, exec_std, NULL);
 }
@@ -190,35 +528,45 @@ size_t fill_insn_buffer(uint8_t *buf, size_t buf_size, uint32_t insn)
     return 4;
 }
 
-static pid_t gettid_wrapper(void) {
-    return syscall(SYS_gettid);
+int t32_is_32bit(uint16_t hw1)
+{
+    // 0b11101, 0b11110 and 0b11111 prefixes start a 32-bit encoding
+    return (hw1 >> 11) >= 0x1d;
+}
+
+/*
+ * T32 candidates are written as hw1:hw2 (hw1 in the upper half), which is
+ * also the order they are stored in memory. A 16-bit candidate gets a nop
+ * as its second halfword so the slot always holds two halfwords.
+ */
+size_t fill_t32_insn_buffer(uint8_t *buf, size_t buf_size, uint32_t insn)
+{
+    if (buf_size < 4)
+        return 0;
+
+    uint16_t hw1 = insn >> 16;
+    uint16_t hw2 = t32_is_32bit(hw1) ? (insn & 0xffff) : T32_NOP;
+
+    buf[0] = hw1 & 0xff;
+    buf[1] = (hw1 >> 8) & 0xff;
+    buf[2] = hw2 & 0xff;
+    buf[3] = (hw2 >> 8) & 0xff;
+    return 4;
 }
 
 int init_watchdog_timer(void) {
-    struct sigevent sev;
-    memset(&sev, 0, sizeof(sev));
-    sev.sigev_notify = SIGEV_THREAD_ID;
-    sev.sigev_signo = SIGRTMIN; 
-    sev._sigev_un._tid = gettid_wrapper(); 
-    
-    if (timer_create(CLOCK_MONOTONIC, &sev, &watchdog_timer) != 0) {
-        perror("timer_create failed");
+    if (ctx_create_timer(&sandbox_default_ctx) != 0)
         return -1;
-    }
+
+    watchdog_timer = sandbox_default_ctx.watchdog_timer;
     return 0;
 }
 
 void arm_watchdog_us(int us) {
-    struct itimerspec its = {
-        .it_value.tv_sec = 0,
-        .it_value.tv_nsec = us * 1000,
-        .it_interval = {0, 0}
-    };
-    timer_settime(watchdog_timer, 0, &its, NULL);
+    ctx_arm_watchdog(&sandbox_default_ctx, us);
 }
 
 
 void disarm_watchdog(void) {
-    struct itimerspec its = {{0, 0}, {0, 0}};
-    timer_settime(watchdog_timer, 0, &its, NULL);
+    ctx_disarm_watchdog(&sandbox_default_ctx);
 }
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "stability.h"
+
+// Rm, Rd/Rs, Rd/Rt, Rn
+static const int field_shifts[] = { 0, 8, 12, 16 };
+
+static uint8_t class_of_record(const FaultRecord *rec)
+{
+    if (rec->signum == 0) {
+        // A slow execution is still an execution, only the ABI list is reproducible
+        return (rec->flags & FAULT_FLAG_EMULATED) ? STAB_CLASS_EMULATED : STAB_CLASS_EXEC;
+    }
+    if (rec->flags & (FAULT_FLAG_LANDED | FAULT_FLAG_STATE_LOST)) {
+        return STAB_CLASS_EXEC;
+    }
+    if (rec->signum == SIGALRM || rec->signum == SIGPROF) {
+        return STAB_CLASS_TIMEOUT;
+    }
+    if (rec->signum == SIGILL) {
+        return STAB_CLASS_SIGILL;
+    }
+    return (uint8_t)(STAB_CLASS_SIGNAL + rec->signum);
+}
+
+void stability_classify_block(const PrevResults *pr, uint32_t base, int thumb, uint8_t *classes,
+                              uint64_t *exec_scratch, uint64_t *covered_scratch)
+{
+    // The top block stops one short, no range can end past UINT32_MAX anyway
+    uint32_t end  = (base > UINT32_MAX - STABILITY_BLOCK) ? UINT32_MAX : base + STABILITY_BLOCK;
+    uint32_t bits = end - base;
+    size_t words  = BITMAP_WORDS(STABILITY_BLOCK);
+
+    memset(classes, STAB_CLASS_NONE, STABILITY_BLOCK);
+    memset(exec_scratch, 0, words * sizeof(uint64_t));
+    memset(covered_scratch, 0, words * sizeof(uint64_t));
+
+    bitmap_file_extract(&pr->exec, base, end, exec_scratch, covered_scratch);
+    for (uint32_t i = 0; i < bits; i++) {
+        if (bitmap_test(covered_scratch, i)) {
+            classes[i] = bitmap_test(exec_scratch, i) ? STAB_CLASS_EXEC : STAB_CLASS_SIGILL;
+        }
+    }
+
+    memset(exec_scratch, 0, words * sizeof(uint64_t));
+    bitmap_file_extract(&pr->timeout, base, end, exec_scratch, NULL);
+    for (size_t i = bitmap_next_set(exec_scratch, bits, 0); i < bits;
+         i = bitmap_next_set(exec_scratch, bits, i + 1)) {
+        classes[i] = STAB_CLASS_TIMEOUT;
+    }
+
+    if (pr->has_faults) {
+        uint32_t lo = 0, hi = pr->fault_count;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (pr->faults[mid].insn < base) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        for (uint32_t i = lo; i < pr->fault_count && pr->faults[i].insn < end; i++) {
+            classes[pr->faults[i].insn - base] = class_of_record(&pr->faults[i]);
+        }
+    }
+
+    // A 16-bit T32 hw1 is only screened as hw1:0000, the rest of it is no outcome
+    if (thumb) {
+        for (uint32_t hw1 = base >> 16; hw1 < (base >> 16) + (STABILITY_BLOCK >> 16); hw1++) {
+            if (!t32_is_32bit((uint16_t)hw1)) {
+                memset(classes + ((hw1 << 16) - base) + 1, STAB_CLASS_NONE, 0xffff);
+            }
+        }
+    }
+}
+
+uint32_t stability_find_suspects(const uint8_t *classes, uint64_t *outvoted, uint64_t *suspects)
+{
+    uint32_t count = 0;
+
+    memset(outvoted, 0, BITMAP_WORDS(STABILITY_BLOCK) * sizeof(uint64_t));
+    memset(suspects, 0, BITMAP_WORDS(STABILITY_BLOCK) * sizeof(uint64_t));
+
+    for (size_t f = 0; f < sizeof(field_shifts) / sizeof(field_shifts[0]); f++) {
+        int shift = field_shifts[f];
+
+        for (uint32_t group = 0; group < STABILITY_BLOCK; group++) {
+            if ((group >> shift) & 0xf) {
+                continue;
+            }
+
+            uint8_t cls[16];
+            int n = 0;
+            for (uint32_t v = 0; v < 16; v++) {
+                cls[v] = classes[group | (v << shift)];
+                n += (cls[v] != STAB_CLASS_NONE);
+            }
+            if (n <= STABILITY_MIN_NEIGHBORS) {
+                continue;
+            }
+
+            // Most common outcome; a group rarely holds more than two
+            uint8_t mode = STAB_CLASS_NONE;
+            int mode_count = 0;
+            for (int v = 0; v < 16; v++) {
+                if (cls[v] == STAB_CLASS_NONE || cls[v] == mode) {
+                    continue;
+                }
+                int k = 0;
+                for (int w = 0; w < 16; w++) {
+                    k += (cls[w] == cls[v]);
+                }
+                if (k > mode_count) {
+                    mode = cls[v];
+                    mode_count = k;
+                }
+            }
+
+            // Outvoted by a clear majority of the other n - 1
+            if (mode_count < STABILITY_MIN_NEIGHBORS || 2 * mode_count <= n - 1) {
+                continue;
+            }
+            // The second field that outvotes an encoding makes it a suspect
+            for (uint32_t v = 0; v < 16; v++) {
+                uint32_t i = group | (v << shift);
+                if (cls[v] == STAB_CLASS_NONE || cls[v] == mode || bitmap_test(suspects, i)) {
+                    continue;
+                }
+                if (!bitmap_test(outvoted, i)) {
+                    bitmap_set(outvoted, i);
+                } else {
+                    bitmap_set(suspects, i);
+                    count++;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+int stability_write(const char *path, int file_number, uint32_t runs,
+                    const StabilityRecord *records, uint32_t count)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "failed to create %s\n", path);
+        return -1;
+    }
+
+    // header：[file_number][record_count][runs]
+    int ret = 0;
+    if (fwrite(&file_number, sizeof(int), 1, f) != 1 ||
+        fwrite(&count, sizeof(uint32_t), 1, f) != 1 ||
+        fwrite(&runs, sizeof(uint32_t), 1, f) != 1 ||
+        fwrite(records, sizeof(StabilityRecord), count, f) != count) {
+        ret = -1;
+    }
+    if (fclose(f) != 0) {
+        ret = -1;
+    }
+    if (ret != 0) {
+        fprintf(stderr, "failed to write %s\n", path);
+    }
+    return ret;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int stability_load_unstable(const char *path, uint32_t **insns_out, uint32_t *count_out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+
+    int file_number;
+    uint32_t count, runs;
+    if (fread(&file_number, sizeof(int), 1, f) != 1 ||
+        fread(&count, sizeof(uint32_t), 1, f) != 1 ||
+        fread(&runs, sizeof(uint32_t), 1, f) != 1) {
+        fprintf(stderr, "%s: header too short\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    uint32_t *insns = (uint32_t *)malloc((count ? count : 1) * sizeof(uint32_t));
+    if (!insns) {
+        perror("malloc unstable encodings failed");
+        fclose(f);
+        return -1;
+    }
+
+    uint32_t kept = 0;
+    StabilityRecord rec;
+    for (uint32_t i = 0; i < count; i++) {
+        if (fread(&rec, sizeof(rec), 1, f) != 1) {
+            fprintf(stderr, "%s: expected %u records\n", path, count);
+            free(insns);
+            fclose(f);
+            return -1;
+        }
+        if (rec.flags & (STABILITY_FLAKY | STABILITY_CHANGED)) {
+            insns[kept++] = rec.insn;
+        }
+    }
+    fclose(f);
+
+    qsort(insns, kept, sizeof(uint32_t), cmp_u32);
+
+    *insns_out = insns;
+    *count_out = kept;
+    return 0;
+}
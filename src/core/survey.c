@@ -0,0 +1,116 @@
+#include "survey.h"
+
+uint64_t survey_next(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t survey_stream(uint64_t seed, int file_number, uint32_t bucket)
+{
+    uint64_t state = seed ^ ((uint64_t)(uint32_t)file_number << 32) ^ bucket;
+    return survey_next(&state);
+}
+
+void survey_wilson(uint64_t hits, uint64_t n, double *lo, double *hi)
+{
+    if (n == 0) {
+        *lo = 0.0;
+        *hi = 1.0;
+        return;
+    }
+
+    double z2     = SURVEY_Z * SURVEY_Z;
+    double p      = (double)hits / (double)n;
+    double denom  = 1.0 + z2 / n;
+    double center = (p + z2 / (2.0 * n)) / denom;
+    double half   = SURVEY_Z * sqrt(p * (1.0 - p) / n + z2 / (4.0 * n * n)) / denom;
+
+    *lo = (center - half < 0.0) ? 0.0 : center - half;
+    *hi = (center + half > 1.0) ? 1.0 : center + half;
+}
+
+double survey_density(const SurveyStratum *s)
+{
+    return s->sampled ? (double)(s->exec + s->timeout) / (double)s->sampled : 0.0;
+}
+
+int survey_write(const char *path, int file_number, uint64_t seed, int bucket_bits,
+                 uint32_t per_stratum, const SurveyStratum *strata, int count)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "failed to create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    fprintf(f, "# res%d survey: seed %" PRIu64 ", %u per stratum, %d bucket bits\n",
+            file_number, seed, per_stratum, bucket_bits);
+    fprintf(f, "# [start, end] population sampled exec timeout density lo95 hi95 est_hits\n");
+
+    for (int i = 0; i < count; i++) {
+        const SurveyStratum *s = &strata[i];
+        double lo, hi;
+        double p = survey_density(s);
+
+        // An exhausted stratum is a count, not an estimate
+        if (s->sampled == s->population) {
+            lo = hi = p;
+        } else {
+            survey_wilson(s->exec + s->timeout, s->sampled, &lo, &hi);
+        }
+
+        fprintf(f, "[%u, %u] %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %.6f %.6f %.6f %.0f\n",
+                s->start, s->end, s->population, s->sampled, s->exec, s->timeout,
+                p, lo, hi, p * (double)s->population);
+    }
+
+    if (fclose(f) != 0) {
+        fprintf(stderr, "failed to write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int survey_read(const char *path, SurveyStratum **strata, int *count)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+
+    char line[256];
+    int file_number = -1;
+    int capacity = *count;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        SurveyStratum s;
+
+        if (line[0] == '#') {
+            sscanf(line, "# res%d survey", &file_number);
+            continue;
+        }
+        if (sscanf(line, "[%u, %u] %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64,
+                   &s.start, &s.end, &s.population, &s.sampled, &s.exec, &s.timeout) != 6) {
+            continue;
+        }
+        s.file_number = file_number;
+
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            SurveyStratum *grown = realloc(*strata, capacity * sizeof(SurveyStratum));
+            if (!grown) {
+                perror("realloc survey strata failed");
+                fclose(f);
+                return -1;
+            }
+            *strata = grown;
+        }
+        (*strata)[(*count)++] = s;
+    }
+
+    fclose(f);
+    return 0;
+}
@@ -1,31 +1,546 @@
 #include "core.h"
 #include "cpu_affinity.h"
+#include "sandbox.h"
+#include "global_map.h"
+#include "survey.h"
+#include <limits.h>
 
+#ifndef NUM_CORES
 #define NUM_CORES 4 // Specify the number of cores to use by including the -d option in the compilation parameters.
+#endif
 #define MAX_FILES 256
 
+// Per-range overhead in encoding equivalents: bitmap alloc, 12-byte header, flush
+#define RANGE_COST      64
+// A T32 file without a range list screens one 2^24 slice
+#define T32_SLICE_INSNS (1u << 24)
+// Weight of the newest observation in a core's rate
+#define RATE_ALPHA      0.3
+// Minimum runtime before a running job's progress is trusted as a rate
+#define RATE_WARMUP_S   5
+
+struct FileJob {
+    int file_number;
+    uint64_t insns;          // encodings to screen
+    uint64_t ranges;
+    uint64_t cost;           // insns + ranges * RANGE_COST
+    uint64_t expected_bytes; // size of the finished resN_complete.bin, 0 if none is written
+    int priority;            // rank in the -P survey summary, INT_MAX if absent
+};
+
+/*
+ * Cores sharing one MIDR. Without -a there is a single cluster holding
+ * every worker; with -a each cluster screens every file on its own
+ * cores, into its own directory, alongside the other clusters.
+ */
+struct Cluster {
+    uint32_t midr;
+    char tag[48];            // empty without -a
+    char output_dir[256];
+    char prev_dir[256];      // with -p: the previous run of this cluster
+    int next_job;
+    int files_processed;
+    int cores;
+};
+
 struct Worker {
     pid_t pid; // child pid
     int core_id;
+    int cluster;
     int busy; //flag
     int file_number;
     time_t start_time; 
     char last_msg[64]; // Last missions
     int jobs_done;
+    struct FileJob *job;
+    double rate;             // cost units per second, refined per finished job
+    int rate_samples;
 };
 
-void refresh_dashboard(struct Worker *workers, int processed, int max, int active) {
+/*
+ * Low-jitter mode: put workers on isolated cores first and measure how
+ * much each worker core is interrupted before any screening starts.
+ */
+static void assign_low_jitter_cores(struct Worker *workers, int count)
+{
+    cpu_set_t isolated, saved;
+    int isolated_count = cpu_isolated_set(&isolated);
+
+    if (isolated_count == 0) {
+        fprintf(stderr, "No isolcpus/nohz_full cores, low-jitter workers share housekeeping cores\n");
+    }
+
+    for (int i = 0; i < count; i++) {
+        int core = cpu_pick_low_jitter(i);
+        if (core >= 0) {
+            workers[i].core_id = core;
+        }
+    }
+
+    if (sched_getaffinity(0, sizeof(saved), &saved) < 0) {
+        perror("sched_getaffinity failed");
+        return;
+    }
+
+    printf("core  isolated  max_gap_us  gaps>%dus/s  over_watchdog\n", JITTER_GAP_NS / 1000);
+    for (int i = 0; i < count; i++) {
+        cpu_set_t one;
+        CPU_ZERO(&one);
+        CPU_SET(workers[i].core_id, &one);
+        if (sched_setaffinity(0, sizeof(one), &one) < 0) {
+            continue;
+        }
+
+        JitterReport jr;
+        jitter_probe(&jr, JITTER_PROBE_MS, WATCHDOG_US * 1000ull);
+        printf("%4d  %8s  %10.1f  %12.1f  %13" PRIu64 "\n",
+               workers[i].core_id, CPU_ISSET(workers[i].core_id, &isolated) ? "yes" : "no",
+               jr.max_gap_ns / 1e3, jr.duration_s > 0 ? jr.gaps_over / jr.duration_s : 0.0,
+               jr.gaps_over_limit);
+    }
+
+    sched_setaffinity(0, sizeof(saved), &saved);
+}
+
+// Cost of one range file, also sizing its result file to track progress
+static int estimate_file_cost(const char *path, struct FileJob *job)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+
+    char line[256];
+    uint32_t start, end;
+
+    job->insns = 0;
+    job->ranges = 0;
+    job->expected_bytes = 2 * sizeof(int);
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "[%u, %u]", &start, &end) == 2 && end > start) {
+            job->insns += end - start;
+            job->ranges++;
+            job->expected_bytes += 3 * sizeof(uint32_t) + (end - start + 7) / 8;
+        }
+    }
+    fclose(f);
+
+    job->cost = job->insns + job->ranges * RANGE_COST;
+    return 0;
+}
+
+// Longest processing time first
+static int cmp_job_cost_desc(const void *a, const void *b)
+{
+    const struct FileJob *x = a, *y = b;
+    if (x->cost != y->cost) return (x->cost < y->cost) ? 1 : -1;
+    return x->file_number - y->file_number;
+}
+
+// Densest survey strata first, then by the file's cost
+static int cmp_job_priority(const void *a, const void *b)
+{
+    const struct FileJob *x = a, *y = b;
+    if (x->priority != y->priority) return (x->priority > y->priority) - (x->priority < y->priority);
+    return cmp_job_cost_desc(a, b);
+}
+
+// Rank of each file by its first line in a survey_summary.txt
+static int load_survey_priority(const char *path, struct FileJob *jobs, int job_count)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "failed to open %s\n", path);
+        return -1;
+    }
+
+    char line[256];
+    int rank = 0;
+    int file_number;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "res%d [", &file_number) != 1) {
+            continue;
+        }
+        for (int j = 0; j < job_count; j++) {
+            if (jobs[j].file_number == file_number && jobs[j].priority == INT_MAX) {
+                jobs[j].priority = rank;
+            }
+        }
+        rank++;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int cmp_stratum_density_desc(const void *a, const void *b)
+{
+    const SurveyStratum *x = a, *y = b;
+    double dx = survey_density(x), dy = survey_density(y);
+
+    if (dx != dy) return (dx < dy) ? 1 : -1;
+    if (x->population != y->population) return (x->population < y->population) ? 1 : -1;
+    if (x->file_number != y->file_number) return x->file_number - y->file_number;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+} SurveyRange;
+
+// The [start, end] lines of a range file, or the whole slice of a T32 file without one
+static int read_file_ranges(const char *input_dir, int thumb, int file_number,
+                            SurveyRange **ranges_out, int *count_out)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/res%d.txt", input_dir, file_number);
+
+    int capacity = 64, count = 0;
+    SurveyRange *ranges = malloc(capacity * sizeof(SurveyRange));
+    if (!ranges) {
+        perror("malloc survey ranges failed");
+        return -1;
+    }
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        if (!thumb) {
+            fprintf(stderr, "failed to open %s\n", path);
+            free(ranges);
+            return -1;
+        }
+        uint64_t end = ((uint64_t)file_number + 1) * T32_SLICE_INSNS;
+        ranges[count++] = (SurveyRange){ (uint32_t)file_number * T32_SLICE_INSNS,
+                                         (end > UINT32_MAX) ? UINT32_MAX : (uint32_t)end };
+    } else {
+        char line[256];
+        uint32_t start, end;
+
+        while (fgets(line, sizeof(line), f) != NULL) {
+            if (sscanf(line, "[%u, %u]", &start, &end) != 2 || end <= start) {
+                continue;
+            }
+            if (count == capacity) {
+                capacity *= 2;
+                SurveyRange *grown = realloc(ranges, capacity * sizeof(SurveyRange));
+                if (!grown) {
+                    perror("realloc survey ranges failed");
+                    free(ranges);
+                    fclose(f);
+                    return -1;
+                }
+                ranges = grown;
+            }
+            ranges[count++] = (SurveyRange){ start, end };
+        }
+        fclose(f);
+    }
+
+    *ranges_out = ranges;
+    *count_out  = count;
+    return 0;
+}
+
+static int cmp_stratum_start(const void *a, const void *b)
+{
+    const SurveyStratum *x = *(const SurveyStratum *const *)a, *y = *(const SurveyStratum *const *)b;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+/*
+ * survey_ranges/resN.txt: the same encodings as the file's own ranges,
+ * but the strata with hits come first, densest first, and the rest after
+ * them, so a full screen from it (-i) reaches the dense buckets early.
+ * strata is sorted densest first.
+ */
+static int write_survey_ranges(const char *dir, const char *input_dir, int thumb, int file_number,
+                               const SurveyStratum *strata, int count)
+{
+    SurveyRange *ranges;
+    int range_count;
+    if (read_file_ranges(input_dir, thumb, file_number, &ranges, &range_count) != 0) {
+        return -1;
+    }
+
+    const SurveyStratum **dense = malloc((count ? count : 1) * sizeof(SurveyStratum *));
+    if (!dense) {
+        perror("malloc dense strata failed");
+        free(ranges);
+        return -1;
+    }
+    int dense_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (strata[i].file_number == file_number && strata[i].exec + strata[i].timeout > 0) {
+            dense[dense_count++] = &strata[i];
+        }
+    }
+
+    char path[300];
+    snprintf(path, sizeof(path), "%s/res%d.txt", dir, file_number);
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "failed to create %s\n", path);
+        free(dense);
+        free(ranges);
+        return -1;
+    }
+
+    // Dense strata, clipped to the file's ranges (a stratum spans the gaps between them)
+    for (int d = 0; d < dense_count; d++) {
+        for (int r = 0; r < range_count; r++) {
+            uint32_t lo = (ranges[r].start > dense[d]->start) ? ranges[r].start : dense[d]->start;
+            uint32_t hi = (ranges[r].end < dense[d]->end) ? ranges[r].end : dense[d]->end;
+            if (lo < hi) {
+                fprintf(f, "[%u, %u]\n", lo, hi);
+            }
+        }
+    }
+
+    // Everything else, in file order; strata never overlap
+    qsort(dense, dense_count, sizeof(SurveyStratum *), cmp_stratum_start);
+    for (int r = 0; r < range_count; r++) {
+        uint32_t lo = ranges[r].start;
+        for (int d = 0; d < dense_count && lo < ranges[r].end; d++) {
+            if (dense[d]->end <= lo || dense[d]->start >= ranges[r].end) {
+                continue;
+            }
+            if (dense[d]->start > lo) {
+                fprintf(f, "[%u, %u]\n", lo, dense[d]->start);
+            }
+            lo = dense[d]->end;
+        }
+        if (lo < ranges[r].end) {
+            fprintf(f, "[%u, %u]\n", lo, ranges[r].end);
+        }
+    }
+
+    fclose(f);
+    free(dense);
+    free(ranges);
+    return 0;
+}
+
+/*
+ * Every stratum of a cluster's resN_survey.txt files, densest first, as
+ * survey_summary.txt: the -P order for the full screen. The total is
+ * bracketed by the per-stratum 95% bounds summed, which is conservative.
+ */
+static int write_survey_summary(const struct Cluster *cl, const struct FileJob *jobs, int job_count,
+                                const char *input_dir, int thumb)
+{
+    SurveyStratum *strata = NULL;
+    int count = 0;
+
+    for (int j = 0; j < job_count; j++) {
+        char survey_file[256];
+        snprintf(survey_file, sizeof(survey_file), "%s/res%d_survey.txt", cl->output_dir, jobs[j].file_number);
+        if (survey_read(survey_file, &strata, &count) != 0) {
+            fprintf(stderr, "No survey for res%d in %s\n", jobs[j].file_number, cl->output_dir);
+        }
+    }
+
+    qsort(strata, count, sizeof(SurveyStratum), cmp_stratum_density_desc);
+
+    uint64_t population = 0, sampled = 0;
+    double estimate = 0.0, total_lo = 0.0, total_hi = 0.0;
+    for (int i = 0; i < count; i++) {
+        const SurveyStratum *st = &strata[i];
+        double p = survey_density(st), lo = p, hi = p;
+
+        if (st->sampled < st->population) {
+            survey_wilson(st->exec + st->timeout, st->sampled, &lo, &hi);
+        }
+        population += st->population;
+        sampled    += st->sampled;
+        estimate   += p * (double)st->population;
+        total_lo   += lo * (double)st->population;
+        total_hi   += hi * (double)st->population;
+    }
+
+    char summary_file[256];
+    snprintf(summary_file, sizeof(summary_file), "%s/survey_summary.txt", cl->output_dir);
+
+    FILE *f = fopen(summary_file, "w");
+    if (!f) {
+        fprintf(stderr, "failed to create %s\n", summary_file);
+        free(strata);
+        return -1;
+    }
+
+    fprintf(f, "# %d strata, %" PRIu64 " of %" PRIu64 " encodings sampled\n", count, sampled, population);
+    fprintf(f, "# estimated hidden: %.0f (%.0f .. %.0f)\n", estimate, total_lo, total_hi);
+    fprintf(f, "# file [start, end] population sampled hits density lo95 hi95 est_hits\n");
+
+    for (int i = 0; i < count; i++) {
+        const SurveyStratum *st = &strata[i];
+        double p = survey_density(st), lo = p, hi = p;
+
+        if (st->sampled < st->population) {
+            survey_wilson(st->exec + st->timeout, st->sampled, &lo, &hi);
+        }
+        fprintf(f, "res%d [%u, %u] %" PRIu64 " %" PRIu64 " %" PRIu64 " %.6f %.6f %.6f %.0f\n",
+                st->file_number, st->start, st->end, st->population, st->sampled,
+                st->exec + st->timeout, p, lo, hi, p * (double)st->population);
+    }
+    fclose(f);
+
+    printf("%s: ~%.0f hidden (%.0f .. %.0f) -> %s\n", cl->tag[0] ? cl->tag : "survey",
+           estimate, total_lo, total_hi, summary_file);
+
+    char ranges_dir[256];
+    snprintf(ranges_dir, sizeof(ranges_dir), "%s/survey_ranges", cl->output_dir);
+    mkdir(ranges_dir, 0755);
+    for (int j = 0; j < job_count; j++) {
+        write_survey_ranges(ranges_dir, input_dir, thumb, jobs[j].file_number, strata, count);
+    }
+    printf("dense strata first -> %s/resN.txt (dispatcher/worker -i)\n", ranges_dir);
+
+    free(strata);
+    return 0;
+}
+
+/*
+ * Fraction of a running job already flushed, judged by its result file
+ * size. Without a result file (-g, -y) it is extrapolated from the core's
+ * rate on its finished jobs, and stays 0 until there is one.
+ */
+static double job_progress(const struct Worker *w, const char *output_dir)
+{
+    char result_file[256];
+    struct stat st;
+
+    if (!w->job) {
+        return 0.0;
+    }
+    if (w->job->expected_bytes == 0) {
+        if (w->rate_samples == 0 || w->job->cost == 0) {
+            return 0.0;
+        }
+        // Never 100% while it still runs
+        double frac = difftime(time(NULL), w->start_time) * w->rate / (double)w->job->cost;
+        return (frac > 0.99) ? 0.99 : frac;
+    }
+
+    snprintf(result_file, sizeof(result_file),
+             "%s/res%d_complete.bin", output_dir, w->file_number);
+    if (stat(result_file, &st) != 0) {
+        return 0.0;
+    }
+
+    double frac = (double)st.st_size / (double)w->job->expected_bytes;
+    return (frac > 1.0) ? 1.0 : frac;
+}
+
+static double worker_rate(const struct Worker *w, const char *output_dir, time_t now)
+{
+    if (w->rate_samples > 0) {
+        return w->rate;
+    }
+
+    if (w->busy && w->job) {
+        double elapsed = difftime(now, w->start_time);
+        double frac = job_progress(w, output_dir);
+        if (elapsed >= RATE_WARMUP_S && frac > 0.0) {
+            return frac * (double)w->job->cost / elapsed;
+        }
+    }
+    return 0.0;
+}
+
+/*
+ * Replay the rest of the schedule: running jobs finish at their current
+ * rate, pending jobs go (in LPT order) to whichever core frees up first.
+ * Cores without a rate yet borrow the mean of the others.
+ * Returns -1 while no rate is known.
+ */
+static long estimate_eta(struct Worker *workers, struct FileJob *jobs, int job_count,
+                         const struct Cluster *clusters, int cluster_count, time_t now)
+{
+    double rates[NUM_CORES];
+    double finish[NUM_CORES];
+    double rate_sum = 0.0;
+    int known = 0;
+
+    for (int i = 0; i < NUM_CORES; i++) {
+        rates[i] = worker_rate(&workers[i], clusters[workers[i].cluster].output_dir, now);
+        if (rates[i] > 0.0) {
+            rate_sum += rates[i];
+            known++;
+        }
+    }
+    if (known == 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < NUM_CORES; i++) {
+        const char *output_dir = clusters[workers[i].cluster].output_dir;
+
+        if (rates[i] <= 0.0) {
+            rates[i] = rate_sum / known;
+        }
+
+        finish[i] = 0.0;
+        if (workers[i].busy && workers[i].job) {
+            double left = (1.0 - job_progress(&workers[i], output_dir)) * (double)workers[i].job->cost;
+            finish[i] = left / rates[i];
+        }
+    }
+
+    // Each cluster works through the whole job list on its own cores
+    for (int c = 0; c < cluster_count; c++) {
+        for (int j = clusters[c].next_job; j < job_count; j++) {
+            int best = -1;
+            for (int i = 0; i < NUM_CORES; i++) {
+                if (workers[i].cluster == c && (best < 0 || finish[i] < finish[best])) best = i;
+            }
+            if (best < 0) {
+                break;
+            }
+            finish[best] += (double)jobs[j].cost / rates[best];
+        }
+    }
+
+    double eta = 0.0;
+    for (int i = 0; i < NUM_CORES; i++) {
+        if (finish[i] > eta) eta = finish[i];
+    }
+    return (long)eta;
+}
+
+static void format_duration(char *buf, size_t size, long seconds)
+{
+    if (seconds < 0) {
+        snprintf(buf, size, "estimating");
+    } else {
+        snprintf(buf, size, "%ldh%02ldm%02lds", seconds / 3600, (seconds / 60) % 60, seconds % 60);
+    }
+}
+
+void refresh_dashboard(struct Worker *workers, const struct Cluster *clusters, int cluster_count,
+                       int processed, int max, int active,
+                       double done_cost, double total_cost, long eta) {
     printf("\033[H\033[2J"); // Refresh Screen
 
     printf("==================== (Dashboard) ====================\n");
     printf("    Overall progress:[");
     int width = 40;
-    int pos = (processed * width) / max;
+    int pos = (total_cost > 0.0) ? (int)(done_cost * width / total_cost) : width;
     for(int i = 0 ; i < width ; ++i) {
         if(i < pos) printf("#");
         else printf(" ");
     }
-    printf("] %d/%d (Active Core: %d)\n", processed, max, active);
+    char eta_str[32];
+    format_duration(eta_str, sizeof(eta_str), eta);
+    printf("] %5.1f%% ETA %s\n", (total_cost > 0.0) ? 100.0 * done_cost / total_cost : 100.0, eta_str);
+    printf("    Files: %d/%d (Active Core: %d)\n", processed, max, active);
+    for (int c = 0; c < cluster_count; c++) {
+        if (clusters[c].tag[0]) {
+            printf("    %-20s %d/%d files on %d cores\n", clusters[c].tag,
+                   clusters[c].files_processed, max / cluster_count, clusters[c].cores);
+        }
+    }
     printf("====================================================================\n");
     printf(" Core | PID   | Processing    | Elapsed  | Total | Status/Last Message \n");
     printf("------+-------+-------------+-------+------+------------------------\n");
@@ -42,8 +557,17 @@ void refresh_dashboard(struct Worker *workers, int processed, int max, int activ
             if (elapsed > 3600) color = "\033[31m";      // Red
             else if (elapsed > 60) color = "\033[33m";   // Yellow
 
-            printf("  %-3d | %-5d | res%-5d.txt | %s%4ds\033[0m  | %-4d | \033[36mProccessing..\033[0m\n", 
-                w->core_id, w->pid, w->file_number, color, elapsed, w->jobs_done);
+            // Live from the result file; the rate is in cost units (insns + RANGE_COST per range)
+            const char *output_dir = clusters[w->cluster].output_dir;
+            double rate = worker_rate(w, output_dir, now);
+            char rate_str[32] = "";
+            if (rate > 0.0) {
+                snprintf(rate_str, sizeof(rate_str), ", %.0f cost/s", rate);
+            }
+
+            printf("  %-3d | %-5d | res%-5d.txt | %s%4ds\033[0m  | %-4d | \033[36mProccessing..\033[0m %5.1f%%%s\n",
+                w->core_id, w->pid, w->file_number, color, elapsed, w->jobs_done,
+                100.0 * job_progress(w, output_dir), rate_str);
         } else {
             // Idle state demonstrate last message
             printf("  %-3d | ----- | ----------- |  ---  | %-4d | %s\n", 
@@ -54,12 +578,190 @@ void refresh_dashboard(struct Worker *workers, int processed, int max, int activ
     fflush(stdout);
 }
 
-int main() {
+/*
+ * Group the worker cores by MIDR (-a), or put them all in one cluster.
+ * Results of cluster "tag" go to output_dir/tag. Returns the count.
+ */
+static int group_clusters(struct Worker *workers, struct Cluster *clusters, int per_microarch,
+                          const char *output_dir, const char *prev_dir)
+{
+    int count = 0;
+
+    for (int i = 0; i < NUM_CORES; i++) {
+        uint32_t midr = 0;
+
+        if (per_microarch && cpu_midr(workers[i].core_id, &midr) != 0) {
+            fprintf(stderr, "No MIDR for core %d, grouped as midr_00000000\n", workers[i].core_id);
+        }
+
+        int c = 0;
+        while (c < count && clusters[c].midr != midr) {
+            c++;
+        }
+
+        if (c == count) {
+            struct Cluster *cl = &clusters[count++];
+            memset(cl, 0, sizeof(*cl));
+            cl->midr = midr;
+
+            if (per_microarch) {
+                midr_tag(midr, cl->tag, sizeof(cl->tag));
+                snprintf(cl->output_dir, sizeof(cl->output_dir), "%s/%s", output_dir, cl->tag);
+                if (prev_dir) {
+                    snprintf(cl->prev_dir, sizeof(cl->prev_dir), "%s/%s", prev_dir, cl->tag);
+                }
+                mkdir(output_dir, 0755);
+                mkdir(cl->output_dir, 0755);
+            } else {
+                snprintf(cl->output_dir, sizeof(cl->output_dir), "%s", output_dir);
+                if (prev_dir) {
+                    snprintf(cl->prev_dir, sizeof(cl->prev_dir), "%s", prev_dir);
+                }
+            }
+        }
+
+        workers[i].cluster = c;
+        clusters[c].cores++;
+    }
+
+    return count;
+}
+
+int main(int argc, char *argv[]) {
+    // a32 screens results_A32/, t32 screens results_T32/ (or whole hw1 slices)
+    const char *mode = "a32";
+    int fork_mode = 0;
+    int low_jitter = 0;
+    int time_exec  = 0;
+    // Screen once per microarchitecture, each on its own cores
+    int per_microarch = 0;
+    // Incremental rescreening, passed through to every worker
+    const char *prev_dir     = NULL;
+    const char *sample_every = NULL;
+    const char *changed_path = NULL;
+    // Shared sparse result map instead of per-file bitmaps
+    const char *global_path  = NULL;
+    // Survey instead of a full screen, passed through to every worker
+    const char *survey_samples = NULL;
+    const char *survey_seed    = NULL;
+    const char *bucket_bits    = NULL;
+    // File order from an earlier survey's survey_summary.txt
+    const char *priority_path  = NULL;
+    // Range files from elsewhere, e.g. an earlier survey's survey_ranges/
+    const char *input_override = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:FlLap:r:u:g:y:e:k:P:i:")) != -1) {
+        switch (opt) {
+        case 'm':
+            mode = optarg;
+            break;
+        case 'F':
+            // Workers survive state-corrupting candidates via the fork server
+            fork_mode = 1;
+            break;
+        case 'l':
+            // Isolated cores, SCHED_FIFO and locked sandbox pages in every worker
+            low_jitter = 1;
+            break;
+        case 'L':
+            // Latency outliers count as kernel-emulated
+            time_exec = 1;
+            break;
+        case 'a':
+            per_microarch = 1;
+            break;
+        case 'p':
+            prev_dir = optarg;
+            break;
+        case 'r':
+            sample_every = optarg;
+            break;
+        case 'u':
+            changed_path = optarg;
+            break;
+        case 'g':
+            global_path = optarg;
+            break;
+        case 'y':
+            survey_samples = optarg;
+            break;
+        case 'e':
+            survey_seed = optarg;
+            break;
+        case 'k':
+            bucket_bits = optarg;
+            break;
+        case 'P':
+            priority_path = optarg;
+            break;
+        case 'i':
+            input_override = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-m a32|t32] [-F] [-l] [-L] [-a] [-p prev_dir [-r sample_every] [-u changed_ranges]]\n"
+                            "          [-g global_map] [-y samples [-e seed] [-k bucket_bits]] [-P survey_summary]\n"
+                            "          [-i input_dir]\n"
+                            "  -a  group cores by MIDR and screen every file once per microarchitecture,\n"
+                            "      results in <bitmap dir>/<core>_rXpY (prev_dir/<core>_rXpY with -p)\n"
+                            "  -y  survey: sample each file's strata (worker -y/-e/-k), then rank all\n"
+                            "      strata by hit density in <bitmap dir>/survey_summary.txt and write\n"
+                            "      <bitmap dir>/survey_ranges/resN.txt, each file with its dense strata first\n"
+                            "  -P  screen files in the order of an earlier survey_summary.txt\n"
+                            "  -i  read resN.txt from input_dir, e.g. <bitmap dir>/survey_ranges\n"
+                            "  With -g or -y no resN_complete.bin is written: a running job's progress\n"
+                            "  is extrapolated from its core's finished jobs, and the ETA reads\n"
+                            "  \"estimating\" until a core has finished one\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    int thumb = (strcmp(mode, "t32") == 0);
+    if (!thumb && strcmp(mode, "a32") != 0) {
+        fprintf(stderr, "Unknown mode %s\n", mode);
+        return 1;
+    }
+    const char *input_dir  = input_override ? input_override : (thumb ? "results_T32" : "results_A32");
+    const char *output_dir = thumb ? "bitmap_results_T32" : "bitmap_results";
+
     if(access("./worker", X_OK) != 0) {
         fprintf(stderr, "Cannot execute ins_check\n");
         return 1;
     }
 
+    if (time_exec && fork_mode) {
+        // Outliers are re-timed in place, a batch child cannot do that
+        fprintf(stderr, "-L cannot be combined with -F\n");
+        return 1;
+    }
+
+    if (survey_samples && (fork_mode || time_exec || prev_dir || global_path)) {
+        // A survey only counts outcomes, it writes no bitmaps to build on
+        fprintf(stderr, "-y cannot be combined with -F, -L, -p or -g\n");
+        return 1;
+    }
+
+    if (global_path) {
+        // One map cannot hold the outcomes of several microarchitectures
+        if (per_microarch) {
+            fprintf(stderr, "-g cannot be combined with -a\n");
+            return 1;
+        }
+        // Rescreening reads the per-file bitmaps of the previous run
+        if (prev_dir) {
+            fprintf(stderr, "-g cannot be combined with -p\n");
+            return 1;
+        }
+
+        // Sized once here, so workers only ever open an existing map
+        GlobalMap global;
+        if (global_map_open(&global, global_path) != 0) {
+            return 1;
+        }
+        global_map_close(&global);
+    }
+
     struct Worker workers[NUM_CORES];
     for(int i = 0; i < NUM_CORES; i++) {
         workers[i].pid = -1;
@@ -67,28 +769,93 @@ int main() {
         workers[i].busy = 0;
         workers[i].file_number = -1;
         workers[i].jobs_done = 0;
+        workers[i].job = NULL;
+        workers[i].rate = 0.0;
+        workers[i].rate_samples = 0;
         sprintf(workers[i].last_msg, "Starting...");
     }
 
+    if (low_jitter) {
+        assign_low_jitter_cores(workers, NUM_CORES);
+    }
+
+    struct Cluster clusters[NUM_CORES];
+    int cluster_count = group_clusters(workers, clusters, per_microarch, output_dir, prev_dir);
+
+    if (per_microarch) {
+        for (int c = 0; c < cluster_count; c++) {
+            printf("%s: %d cores -> %s\n", clusters[c].tag, clusters[c].cores, clusters[c].output_dir);
+        }
+    }
+
+    // Cost model: one job per input file, scheduled longest first
+    struct FileJob jobs[MAX_FILES];
+    int job_count = 0;
+    double total_cost = 0.0;
+    double finished_cost = 0.0;
+
+    for (int f = 0; f < MAX_FILES; f++) {
+        char input_filename[100];
+        snprintf(input_filename, sizeof(input_filename), "%s/res%d.txt", input_dir, f);
+
+        struct FileJob *job = &jobs[job_count];
+        job->file_number = f;
+        job->priority = INT_MAX;
+
+        if (estimate_file_cost(input_filename, job) != 0) {
+            // A T32 worker screens the whole slice when there is no range file
+            if (!thumb) {
+                continue;
+            }
+            job->insns = T32_SLICE_INSNS;
+            job->ranges = T32_SLICE_INSNS >> 16;
+            job->cost = job->insns + job->ranges * RANGE_COST;
+            job->expected_bytes = 2 * sizeof(int) +
+                                  job->ranges * (3 * sizeof(uint32_t) + (1u << 16) / 8);
+        }
+
+        if (job->ranges == 0) {
+            continue;
+        }
+        // The global map and the survey write no resN_complete.bin to watch
+        if (global_path || survey_samples) {
+            job->expected_bytes = 0;
+        }
+        total_cost += (double)job->cost;
+        job_count++;
+    }
+
+    qsort(jobs, job_count, sizeof(struct FileJob), cmp_job_cost_desc);
+    if (priority_path) {
+        if (load_survey_priority(priority_path, jobs, job_count) != 0) {
+            return 1;
+        }
+        qsort(jobs, job_count, sizeof(struct FileJob), cmp_job_priority);
+    }
+
+    // Every cluster screens every file
+    total_cost *= cluster_count;
+
     int files_processed = 0;
-    int current_file = 0;
+    int pending = job_count * cluster_count;
+    int active_workers = 0;
 
-    while(files_processed < MAX_FILES || current_file < MAX_FILES) {
+    while(pending > 0 || active_workers > 0) {
         for(int w = 0; w < NUM_CORES; w++) {
-            if(!workers[w].busy && current_file < MAX_FILES) {
-                char input_filename[100];
-                snprintf(input_filename, sizeof(input_filename), "results_A32/res%d.txt", current_file);
-                
-                if(access(input_filename, R_OK) != 0) {
-                    snprintf(workers[w].last_msg, 64, "\033[33mEscape(No File): %d\033[0m", current_file);
-                    current_file++;
-                    continue;
-                }
+            struct Cluster *cl = &clusters[workers[w].cluster];
+
+            if(!workers[w].busy && cl->next_job < job_count) {
+                struct FileJob *job = &jobs[cl->next_job];
+                int current_file = job->file_number;
 
                 pid_t pid = fork();
                 if(pid < 0) {
                     perror("fork failed");
-                    current_file++;
+                    finished_cost += (double)job->cost;
+                    cl->next_job++;
+                    cl->files_processed++;
+                    pending--;
+                    files_processed++;
                 } else if(pid == 0) {
                     if(set_cpu_affinity(getpid(), workers[w].core_id) < 0) {
                         fprintf(stderr, "Cannot set child process %d to core %d\n", 
@@ -98,7 +865,60 @@ int main() {
                     char file_num_str[20];
                     snprintf(file_num_str, sizeof(file_num_str), "%d", current_file);
                     
-                    execl("./worker", "worker", file_num_str, NULL);
+                    char *worker_argv[32];
+                    int worker_argc = 0;
+                    worker_argv[worker_argc++] = "worker";
+                    worker_argv[worker_argc++] = "-m";
+                    worker_argv[worker_argc++] = (char *)mode;
+                    if (fork_mode) {
+                        worker_argv[worker_argc++] = "-F";
+                    }
+                    if (low_jitter) {
+                        worker_argv[worker_argc++] = "-l";
+                    }
+                    if (time_exec) {
+                        worker_argv[worker_argc++] = "-L";
+                    }
+                    if (per_microarch) {
+                        worker_argv[worker_argc++] = "-o";
+                        worker_argv[worker_argc++] = cl->output_dir;
+                    }
+                    if (input_override) {
+                        worker_argv[worker_argc++] = "-i";
+                        worker_argv[worker_argc++] = (char *)input_override;
+                    }
+                    if (prev_dir) {
+                        worker_argv[worker_argc++] = "-p";
+                        worker_argv[worker_argc++] = cl->prev_dir;
+                        if (sample_every) {
+                            worker_argv[worker_argc++] = "-r";
+                            worker_argv[worker_argc++] = (char *)sample_every;
+                        }
+                        if (changed_path) {
+                            worker_argv[worker_argc++] = "-u";
+                            worker_argv[worker_argc++] = (char *)changed_path;
+                        }
+                    }
+                    if (global_path) {
+                        worker_argv[worker_argc++] = "-g";
+                        worker_argv[worker_argc++] = (char *)global_path;
+                    }
+                    if (survey_samples) {
+                        worker_argv[worker_argc++] = "-y";
+                        worker_argv[worker_argc++] = (char *)survey_samples;
+                        if (survey_seed) {
+                            worker_argv[worker_argc++] = "-e";
+                            worker_argv[worker_argc++] = (char *)survey_seed;
+                        }
+                        if (bucket_bits) {
+                            worker_argv[worker_argc++] = "-k";
+                            worker_argv[worker_argc++] = (char *)bucket_bits;
+                        }
+                    }
+                    worker_argv[worker_argc++] = file_num_str;
+                    worker_argv[worker_argc] = NULL;
+
+                    execv("./worker", worker_argv);
                     perror("./worker failed!");
                     _exit(1);
                 } else {
@@ -106,13 +926,17 @@ int main() {
                     workers[w].busy = 1;
                     workers[w].file_number = current_file;
                     workers[w].start_time = time(NULL);
+                    workers[w].job = job;
                     
-                    current_file++;
+                    cl->next_job++;
+                    pending--;
                 }
             }
         }
 
         for(int w = 0; w < NUM_CORES; w++) {
+            struct Cluster *cl = &clusters[workers[w].cluster];
+
             if(workers[w].busy) {
                 time_t current_time = time(NULL);
                 int elapsed = current_time - workers[w].start_time;
@@ -123,9 +947,12 @@ int main() {
                     waitpid(workers[w].pid, NULL, 0);
                     
                     snprintf(workers[w].last_msg, 64, "\033[31mTimeOut Terminate res%d\033[0m", workers[w].file_number);
+                    finished_cost += (double)workers[w].job->cost;
                     workers[w].pid = -1;
                     workers[w].busy = 0;
                     workers[w].file_number = -1;
+                    workers[w].job = NULL;
+                    cl->files_processed++;
                     files_processed++;
                     continue;
                 }
@@ -133,7 +960,7 @@ int main() {
                 // Detect Result file update time
                 char result_file[256];
                 snprintf(result_file, sizeof(result_file), 
-                        "bitmap_results/res%d_complete.bin", workers[w].file_number);
+                        "%s/res%d_complete.bin", cl->output_dir, workers[w].file_number);
                 struct stat st;
                 if (stat(result_file, &st) == 0) {
                     time_t file_age = current_time - st.st_mtime;
@@ -162,19 +989,42 @@ int main() {
                     } else {
                         snprintf(workers[w].last_msg, 64, "\033[31mTerminated res%d\033[0m", workers[w].file_number);
                     }
+
+                    // Only clean runs say anything about this core's speed
+                    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+                        double observed = (double)workers[w].job->cost / (elapsed > 0 ? elapsed : 1);
+                        workers[w].rate = workers[w].rate_samples
+                                        ? (1.0 - RATE_ALPHA) * workers[w].rate + RATE_ALPHA * observed
+                                        : observed;
+                        workers[w].rate_samples++;
+                    }
+                    finished_cost += (double)workers[w].job->cost;
+                    workers[w].jobs_done++;
                     
                     workers[w].pid = -1;
                     workers[w].busy = 0;
                     workers[w].file_number = -1;
+                    workers[w].job = NULL;
+                    cl->files_processed++;
                     files_processed++;
                 }
             }
         }
 
-        int active_workers = 0;
-        for(int i=0; i<NUM_CORES; i++) if(workers[i].busy) active_workers++;
-        
-        refresh_dashboard(workers, files_processed, MAX_FILES, active_workers);
+        active_workers = 0;
+        double done_cost = finished_cost;
+        time_t now = time(NULL);
+        for(int i=0; i<NUM_CORES; i++) {
+            if(workers[i].busy) {
+                active_workers++;
+                done_cost += job_progress(&workers[i], clusters[workers[i].cluster].output_dir) *
+                             (double)workers[i].job->cost;
+            }
+        }
+
+        long eta = estimate_eta(workers, jobs, job_count, clusters, cluster_count, now);
+        refresh_dashboard(workers, clusters, cluster_count, files_processed, job_count * cluster_count,
+                          active_workers, done_cost, total_cost, eta);
 
         usleep(200000);
 
@@ -182,5 +1032,11 @@ int main() {
     
     printf("\n\nAll File Process Done! Total: %d files\n", files_processed);
 
+    if (survey_samples) {
+        for (int c = 0; c < cluster_count; c++) {
+            write_survey_summary(&clusters[c], jobs, job_count, input_dir, thumb);
+        }
+    }
+
     return 0;
 }
\ No newline at end of file
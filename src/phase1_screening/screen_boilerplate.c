@@ -0,0 +1,87 @@
+#include "core.h"
+#include "sandbox.h"
+
+void execution_boilerplate(void);
+
+void execution_boilerplate(void)
+{
+        __asm__ __volatile__(
+            ".global boilerplate_start  \n"
+            "boilerplate_start:         \n"
+
+            // Store all gregs
+            "push {r0-r12, lr}          \n"
+
+            /*
+             * The frame is found again through TPIDRURW, which only an
+             * mcr to c13 can change, instead of a VFP register that any
+             * NEON/VFP candidate may overwrite: [frame] is the caller's
+             * TPIDRURW, [frame + 4] a canary checked on the way back.
+             */
+            "mrc p15, 0, r0, c13, c0, 2 \n"
+            "movw r1, %[canary_lo]      \n"
+            "movt r1, %[canary_hi]      \n"
+            "push {r0, r1}              \n"
+            "mov r0, sp                 \n"
+            "mcr p15, 0, r0, c13, c0, 2 \n"
+
+            // Reset the regs to make insn execution deterministic
+            // and avoid program corruption
+            "mov r0, %[reg_init]        \n"
+            "mov r1, %[reg_init]        \n"
+            "mov r2, %[reg_init]        \n"
+            "mov r3, %[reg_init]        \n"
+            "mov r4, %[reg_init]        \n"
+            "mov r5, %[reg_init]        \n"
+            "mov r6, %[reg_init]        \n"
+            "mov r7, %[reg_init]        \n"
+            "mov r8, %[reg_init]        \n"
+            "mov r9, %[reg_init]        \n"
+            "mov r10, %[reg_init]       \n"
+            "mov r11, %[reg_init]       \n"
+            "mov r12, %[reg_init]       \n"
+            "mov lr, %[reg_init]        \n"
+            "mov sp, %[reg_init]        \n"
+
+            // Note: this msr insn must be directly above the nop
+            // because of the -c option (excluding the label ofc)
+           "msr cpsr_f, #0             \n"
+
+            ".global insn_location      \n"
+            "insn_location:             \n"
+
+            // This instruction will be replaced with the one to be tested
+            "nop                        \n"
+
+            /*
+             * Whatever the candidate did to SP, the frame comes back from
+             * TPIDRURW. A clobbered TPIDRURW faults on the canary load or
+             * fails the compare and hits the udf; either way the signal
+             * comes from after the candidate (see signal_handler).
+             */
+            "mrc p15, 0, r0, c13, c0, 2 \n"
+            "ldr r1, [r0, #4]           \n"
+            "movw r2, %[canary_lo]      \n"
+            "movt r2, %[canary_hi]      \n"
+            "cmp r1, r2                 \n"
+            "bne 1f                     \n"
+            "mov sp, r0                 \n"
+            "pop {r0, r1}               \n"
+            "mcr p15, 0, r0, c13, c0, 2 \n"
+
+            // Restore all gregs
+            "pop {r0-r12, lr}           \n"
+
+            "bx lr                      \n"
+            "1:                         \n"
+            "udf %[lost_trap]           \n"
+            ".global boilerplate_end    \n"
+            "boilerplate_end:           \n"
+            :
+            : [reg_init]  "n" (0),
+              [canary_lo] "n" (SCREEN_CANARY & 0xffff),
+              [canary_hi] "n" (SCREEN_CANARY >> 16),
+              [lost_trap] "n" (SCREEN_LOST_TRAP)
+            );
+
+}
@@ -1,104 +1,1465 @@
 #include "core.h"
 #include "sandbox.h"
 #include "bitmap.h"
+#include "cpu_affinity.h"
+#include "fork_server.h"
+#include "rescreen.h"
+#include "global_map.h"
+#include "emulation.h"
+#include "hit_ring.h"
+#include "survey.h"
+#include "range_trace.h"
+#include "stability.h"
 
-void execution_boilerplate(void);
+#define MAX_SCREEN_THREADS 64
 
-void execution_boilerplate(void)
-{
-        __asm__ __volatile__(
-            ".global boilerplate_start  \n"
-            "boilerplate_start:         \n"
+// T32 files cover one 2^24 slice of hw1:hw2 when no range file exists
+#define T32_SLICE_SHIFT    24
 
-            // Store all gregs
-            "push {r0-r12, lr}          \n"
+extern char t32_boilerplate_start, t32_boilerplate_end, t32_insn_location;
 
-            /*
-             * It's better to use ptrace in cases where the sp might
-             * be corrupted, but storing the sp in a vector reg
-             * mitigates the issue somewhat.
-             */
-            "vmov s0, sp                \n"
+static const SandboxTemplate t32_template = {
+    .start    = &t32_boilerplate_start,
+    .end      = &t32_boilerplate_end,
+    .location = &t32_insn_location,
+    .thumb    = 1,
+};
 
-            // Reset the regs to make insn execution deterministic
-            // and avoid program corruption
-            "mov r0, %[reg_init]        \n"
-            "mov r1, %[reg_init]        \n"
-            "mov r2, %[reg_init]        \n"
-            "mov r3, %[reg_init]        \n"
-            "mov r4, %[reg_init]        \n"
-            "mov r5, %[reg_init]        \n"
-            "mov r6, %[reg_init]        \n"
-            "mov r7, %[reg_init]        \n"
-            "mov r8, %[reg_init]        \n"
-            "mov r9, %[reg_init]        \n"
-            "mov r10, %[reg_init]       \n"
-            "mov r11, %[reg_init]       \n"
-            "mov r12, %[reg_init]       \n"
-            "mov lr, %[reg_init]        \n"
-            "mov sp, %[reg_init]        \n"
+/*
+ * Second halfwords tried on a 32-bit T32 prefix before expanding it.
+ * If every probe raises SIGILL the core rejects the prefix as a whole
+ * and its 65536 encodings are skipped. The coprocessor space is never
+ * pruned (T32_PREFIX_COPROC): whether it decodes hangs on coproc in
+ * hw2[11:8], which the probes do not cover.
+ */
+#define T32_PREFIX_COPROC(hw1)  (((hw1) & 0xec00) == 0xec00)   // ec00-efff, fc00-ffff
+static const uint16_t t32_prefix_probes[] = {
+    0x0000, 0xffff,
+    0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080,
+    0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000, 0x8000,
+};
 
-            // Note: this msr insn must be directly above the nop
-            // because of the -c option (excluding the label ofc)
-           "msr cpsr_f, #0             \n"
+typedef struct {
+    const char *name;
+    const char *input_dir;
+    const char *output_dir;
+    const SandboxTemplate *tpl;            // NULL: default A32 boilerplate
+} ScreenMode;
 
-            ".global insn_location      \n"
-            "insn_location:             \n"
+static const ScreenMode screen_modes[] = {
+    { "a32", "results_A32", "bitmap_results",     NULL          },
+    { "t32", "results_T32", "bitmap_results_T32", &t32_template },
+};
 
-            // This instruction will be replaced with the one to be tested
-            "nop                        \n"
+typedef struct {
+    uint32_t    start;
+    uint32_t    end;
+    RangeBitmap rb;
+    int         valid;      // rb was allocated
+    int         screened;   // ready to be flushed
+} RangeJob;
 
-            "vmov sp, s0                \n"
+// Part of an input range inside one survey bucket
+typedef struct {
+    uint32_t bucket;
+    uint32_t start;
+    uint32_t end;
+} SurveyPiece;
 
-            // Restore all gregs
-            "pop {r0-r12, lr}           \n"
+typedef struct {
+    SurveyStratum s;
+    uint32_t      bucket;
+    int           first_piece;             // its pieces, consecutive in the queue's
+    int           piece_count;
+} SurveyJob;
 
-            "bx lr                      \n"
-            ".global boilerplate_end    \n"
-            "boilerplate_end:           \n"
-            :
-            : [reg_init] "n" (0)
-            );
+// One aligned 2^20 block of the stability pass and its suspects
+typedef struct {
+    uint32_t         base;
+    uint32_t         count;
+    StabilityRecord *records;
+} StabilityBlock;
 
-}
+/*
+ * Ranges of one input file, parsed once and shared by all screening
+ * threads. Threads claim jobs in order and results are flushed in input
+ * order, so the output layout does not depend on the thread count.
+ */
+typedef struct {
+    RangeJob *jobs;
+    int       job_count;
+    int       next_job;
+    int       next_flush;
+    int       timeout_range_count;
+    int       flush_failed;
+    int       file_number;
+
+    const ScreenMode *mode;
+    const char *output_dir;                // mode's, unless -o
+    int       prune;
+    uint64_t *pruned_hw1;                  // T32 prefixes rejected by the probes
+
+    uint32_t  fork_batch;                  // 0: screen in-process
+    int       low_jitter;                  // SCHED_FIFO, locked pages, self-check
+    int       time_exec;                   // flag latency outliers as emulated
+    int       seccomp;                     // syscalls from the insn page raise SIGSYS
+    EmulationConfig emu;
+    FILE     *crash_file;
+
+    FaultLogFile faults;                   // non-SIGILL outcomes, resN_faults.bin
+    RangeTraceFile *trace;                 // -t: one record per range, resN_trace.bin
+
+    PrevResults *prev;                     // NULL: screen every encoding
+    unsigned int sample_seed;
+    uint64_t     rescreen_executed;
+    uint64_t     rescreen_sampled;
+    uint64_t     rescreen_drifted;
+
+    FILE     *output_file;                 // NULL with a global map
+    FILE     *timeout_file;
+    GlobalMap *global;                     // -g: outcomes go straight to the shared map
+    const char *ring_dir;                  // -q: each thread streams hits to a ring here
+    uint64_t   ring_dropped;
+
+    // -y: threads claim strata to sample instead of jobs to screen
+    SurveyJob   *survey;
+    int          survey_count;
+    int          next_survey;
+    SurveyPiece *survey_pieces;
+    uint32_t     survey_samples;
+    uint64_t     survey_seed;
 
+    // -s: threads claim blocks of the finished results in prev
+    StabilityBlock *stability;
+    int          stability_count;
+    int          next_stability;
+    uint32_t     stability_runs;
+    pthread_mutex_t flush_lock;
+} ScreenQueue;
 
-static int count_ranges_in_file(FILE *f, uint64_t *total_insns_out)
+typedef struct {
+    ScreenQueue *queue;
+    int          index;
+    int          core_id;   // -1: keep the affinity inherited from the dispatcher
+    int          status;
+    pthread_t    thread;
+} ScreenThread;
+
+static int load_ranges_from_file(FILE *f, RangeJob **jobs_out, uint64_t *total_insns_out)
 {
     char line[256];
     int count = 0;
+    int capacity = 0;
     uint32_t start, end;
     uint64_t total = 0;
+    RangeJob *jobs = NULL;
 
     fseek(f, 0, SEEK_SET);
 
     while (fgets(line, sizeof(line), f) != NULL) {
-        if (sscanf(line, "[%u, %u]", &start, &end) == 2) {
-            count++;
-            if (end > start) {
-                total += (uint64_t)(end - start);
+        if (sscanf(line, "[%u, %u]", &start, &end) != 2) {
+            continue;
+        }
+        if (end <= start) {
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            RangeJob *grown = realloc(jobs, (size_t)capacity * sizeof(RangeJob));
+            if (!grown) {
+                perror("realloc jobs failed");
+                free(jobs);
+                return -1;
             }
+            jobs = grown;
         }
+
+        memset(&jobs[count], 0, sizeof(RangeJob));
+        jobs[count].start = start;
+        jobs[count].end   = end;
+        total += (uint64_t)(end - start);
+        count++;
     }
 
     fseek(f, 0, SEEK_SET);
     if (total_insns_out) {
         *total_insns_out = total;
     }
+    *jobs_out = jobs;
     return count;
 }
 
-int main(int argc, const char* argv[]) {
-    
-    if(argc < 2) {
-        fprintf(stderr, "Usage: %s <file_number>\n", argv[0]);
-        fprintf(stderr, "Example: %s 1  # Handling results_A32/res1.txt\n", argv[0]);
+// Every hw1 prefix of a T32 slice as its own job, so threads can share it
+static int slice_ranges_t32(int file_number, RangeJob **jobs_out, uint64_t *total_insns_out)
+{
+    int count = 1 << (T32_SLICE_SHIFT - 16);
+    uint32_t base = (uint32_t)file_number << T32_SLICE_SHIFT;
+
+    RangeJob *jobs = calloc((size_t)count, sizeof(RangeJob));
+    if (!jobs) {
+        perror("calloc jobs failed");
+        return -1;
+    }
+
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t end = (uint64_t)base + ((uint64_t)(i + 1) << 16);
+
+        jobs[i].start = base + ((uint32_t)i << 16);
+        // [start, end) cannot reach 2^32, the very last encoding is dropped
+        jobs[i].end   = (end > UINT32_MAX) ? UINT32_MAX : (uint32_t)end;
+        total += jobs[i].end - jobs[i].start;
+    }
+
+    if (total_insns_out) {
+        *total_insns_out = total;
+    }
+    *jobs_out = jobs;
+    return count;
+}
+
+// Where a thread's outcomes go: the job's bitmap and the thread's fault log
+typedef struct {
+    RangeBitmap     *rb;
+    FaultLog        *log;
+    GlobalMapWindow *gw;                   // replaces the rb maps when set
+
+    const EmulationConfig *emu;
+    int              thumb;
+    LatencyBaseline *lat;                  // NULL: executions are not timed
+    HitRing         *ring;                 // NULL: no phase-2 consumer stream
+    RangeTrace      *trace;                // NULL: ranges are not traced
+    int              log_failed;           // a fault log flush failed during this job
+} OutcomeSink;
+
+static void record_outcome(OutcomeSink *sink, const FaultRecord *rec)
+{
+    int signum = rec->signum;
+    FaultRecord tagged;
+
+    if (sink->trace) {
+        range_trace_count(sink->trace, signum);
+    }
+
+    int cls = (signum == 0) ? emulation_match(sink->emu, rec->insn, sink->thumb) : 0;
+    if (cls) {
+        tagged = *rec;
+        tagged.flags  |= FAULT_FLAG_EMULATED;
+        tagged.si_code = (int16_t)cls;
+        rec = &tagged;
+    }
+
+    // Landed in the trap zone or clobbered the frame: it did execute
+    int landed   = rec->flags & (FAULT_FLAG_LANDED | FAULT_FLAG_STATE_LOST);
+    // Executed, but by the kernel: a separate class phase 2 skips
+    int emulated = rec->flags & (FAULT_FLAG_EMULATED | FAULT_FLAG_SLOW);
+
+    int exec   = 0;
+    int logged = emulated || (signum != 0 && (signum != SIGILL || landed));
+
+    if (signum == SIGALRM || signum == SIGPROF) {
+        if (sink->gw) {
+            global_map_mark(sink->gw, GLOBAL_PLANE_TIMEOUT, rec->insn);
+        } else {
+            range_bitmap_mark_timeout(sink->rb, rec->insn);
+        }
+    } else if ((signum == 0 && !emulated) || landed) {
+        exec = 1;
+        if (sink->gw) {
+            global_map_mark(sink->gw, GLOBAL_PLANE_EXEC, rec->insn);
+        } else {
+            range_bitmap_mark_exec(sink->rb, rec->insn);
+        }
+    } else {
+        // crash
+    }
+
+    if (logged && fault_log_append(sink->log, rec) != 0) {
+        sink->log_failed = 1;
+    }
+
+    // Phase 2 has nothing to learn from the kernel's emulation
+    if (sink->ring && !emulated && (exec || logged)) {
+        hit_ring_push(sink->ring, rec);
+    }
+}
+
+/*
+ * Run a latency outlier again. It is slow for good only if every retry
+ * executes and is an outlier too; best_ns keeps the fastest time.
+ */
+static int still_slow(SandboxContext *ctx, LatencyBaseline *lat, uint32_t insn, uint32_t *best_ns)
+{
+    uint8_t insn_bytes[4];
+    size_t buf_len = ctx->thumb ? fill_t32_insn_buffer(insn_bytes, sizeof(insn_bytes), insn)
+                                : fill_insn_buffer(insn_bytes, sizeof(insn_bytes), insn);
+
+    for (int i = 0; i < LATENCY_RETRIES; i++) {
+        sandbox_ctx_execute_screen(ctx, insn_bytes, buf_len);
+        if (ctx->last_insn_signum != 0) {
+            return 0;
+        }
+        if (ctx->exec_ns < *best_ns) {
+            *best_ns = ctx->exec_ns;
+        }
+        if (!latency_is_outlier(lat, ctx->exec_ns)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// SIGILL is the common case and carries nothing worth logging
+static void record_ctx_outcome(OutcomeSink *sink, SandboxContext *ctx, uint32_t insn)
+{
+    FaultRecord rec;
+
+    if (ctx->last_insn_signum == SIGILL && !ctx->landed && !ctx->state_lost) {
+        if (sink->trace) {
+            range_trace_count(sink->trace, SIGILL);
+        }
+        return;
+    }
+
+    fault_record_from_ctx(&rec, insn, ctx);
+
+    // Known emulations are tagged by record_outcome without retries
+    if (rec.signum == 0 && sink->lat && !emulation_match(sink->emu, insn, sink->thumb)) {
+        uint32_t best_ns = ctx->exec_ns;
+        if (latency_is_outlier(sink->lat, best_ns) && still_slow(ctx, sink->lat, insn, &best_ns)) {
+            rec.flags |= FAULT_FLAG_SLOW;
+        }
+        rec.fault_addr = best_ns;
+    }
+
+    record_outcome(sink, &rec);
+}
+
+static void screen_range(SandboxContext *ctx, OutcomeSink *sink)
+{
+    RangeBitmap *rb = sink->rb;
+
+    for (uint32_t insn = rb->start; insn < rb->end; ++insn) {
+
+        uint8_t insn_bytes[4];
+        size_t buf_len = fill_insn_buffer(insn_bytes, sizeof(insn_bytes), insn);
+
+        sandbox_ctx_execute_screen(ctx, insn_bytes, buf_len);
+
+        record_ctx_outcome(sink, ctx, insn);
+    }
+}
+
+static int t32_prefix_rejected(SandboxContext *ctx, uint16_t hw1)
+{
+    if (T32_PREFIX_COPROC(hw1)) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < sizeof(t32_prefix_probes) / sizeof(t32_prefix_probes[0]); i++) {
+        uint8_t insn_bytes[4];
+        uint32_t insn = ((uint32_t)hw1 << 16) | t32_prefix_probes[i];
+        size_t buf_len = fill_t32_insn_buffer(insn_bytes, sizeof(insn_bytes), insn);
+
+        sandbox_ctx_execute_screen(ctx, insn_bytes, buf_len);
+
+        if (ctx->last_insn_signum != SIGILL || ctx->landed || ctx->state_lost) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Walk the range one hw1 prefix at a time. A 16-bit hw1 is executed once
+ * and recorded at hw1:0000, a 32-bit hw1 is only expanded into its second
+ * halfwords when the prefix probes show the core accepts it.
+ */
+static void screen_range_t32(SandboxContext *ctx, OutcomeSink *sink, ScreenQueue *q)
+{
+    RangeBitmap *rb = sink->rb;
+    uint32_t first_hw1 = rb->start >> 16;
+    uint32_t last_hw1  = (rb->end - 1) >> 16;
+
+    for (uint32_t hw1 = first_hw1; hw1 <= last_hw1; hw1++) {
+        uint64_t prefix_base = (uint64_t)hw1 << 16;
+        uint32_t lo = (rb->start > prefix_base) ? rb->start : (uint32_t)prefix_base;
+        uint64_t hi = (rb->end < prefix_base + 0x10000) ? rb->end : prefix_base + 0x10000;
+        uint8_t insn_bytes[4];
+        size_t buf_len;
+
+        if (!t32_is_32bit(hw1)) {
+            if (lo == prefix_base) {
+                buf_len = fill_t32_insn_buffer(insn_bytes, sizeof(insn_bytes), lo);
+                sandbox_ctx_execute_screen(ctx, insn_bytes, buf_len);
+                record_ctx_outcome(sink, ctx, lo);
+            }
+            continue;
+        }
+
+        if (q->prune && t32_prefix_rejected(ctx, hw1)) {
+            bitmap_set_atomic(q->pruned_hw1, hw1);
+            continue;
+        }
+
+        for (uint64_t insn = lo; insn < hi; ++insn) {
+            buf_len = fill_t32_insn_buffer(insn_bytes, sizeof(insn_bytes), (uint32_t)insn);
+            sandbox_ctx_execute_screen(ctx, insn_bytes, buf_len);
+            record_ctx_outcome(sink, ctx, (uint32_t)insn);
+        }
+    }
+}
+
+static int screen_one_a32(SandboxContext *ctx, uint32_t insn, void *arg)
+{
+    (void)arg;
+    uint8_t insn_bytes[4];
+    size_t buf_len = fill_insn_buffer(insn_bytes, sizeof(insn_bytes), insn);
+
+    sandbox_ctx_execute_screen(ctx, insn_bytes, buf_len);
+    return 0;
+}
+
+// Same canonical form as screen_range_t32: 16-bit hw1 only at hw1:0000
+static int screen_one_t32(SandboxContext *ctx, uint32_t insn, void *arg)
+{
+    (void)arg;
+    uint8_t insn_bytes[4];
+
+    if (!t32_is_32bit(insn >> 16) && (insn & 0xffff) != 0) {
+        return -1;
+    }
+
+    size_t buf_len = fill_t32_insn_buffer(insn_bytes, sizeof(insn_bytes), insn);
+    sandbox_ctx_execute_screen(ctx, insn_bytes, buf_len);
+    return 0;
+}
+
+/*
+ * Outcome of the last run in the classes of stability.h, read the way
+ * record_outcome reads it (no latency retries, so slow means exec).
+ */
+static uint8_t stability_class_of_ctx(const SandboxContext *ctx, const EmulationConfig *emu, uint32_t insn)
+{
+    int signum = ctx->last_insn_signum;
+
+    if (signum == SIGALRM || signum == SIGPROF) {
+        return STAB_CLASS_TIMEOUT;
+    }
+    if (ctx->landed || ctx->state_lost) {
+        return STAB_CLASS_EXEC;
+    }
+    if (signum == 0) {
+        return emulation_match(emu, insn, ctx->thumb) ? STAB_CLASS_EMULATED : STAB_CLASS_EXEC;
+    }
+    if (signum == SIGILL) {
+        return STAB_CLASS_SIGILL;
+    }
+    return (uint8_t)(STAB_CLASS_SIGNAL + signum);
+}
+
+static void stability_rerun(SandboxContext *ctx, ScreenQueue *q, StabilityRecord *rec)
+{
+    int (*screen_one)(SandboxContext *, uint32_t, void *) = ctx->thumb ? screen_one_t32 : screen_one_a32;
+    uint8_t seen[256] = { 0 };
+    uint8_t first = STAB_CLASS_NONE;
+
+    rec->flags  = 0;
+    rec->agreed = 0;
+    rec->other  = STAB_CLASS_NONE;
+
+    for (uint32_t run = 0; run < q->stability_runs; run++) {
+        screen_one(ctx, rec->insn, NULL);
+        uint8_t cls = stability_class_of_ctx(ctx, &q->emu, rec->insn);
+
+        if (run == 0) {
+            first = cls;
+        } else if (cls != first) {
+            rec->flags |= STABILITY_FLAKY;
+        }
+
+        if (cls == rec->recorded) {
+            rec->agreed++;
+        } else if (++seen[cls] > seen[rec->other]) {
+            rec->other = cls;
+        }
+    }
+
+    if (!(rec->flags & STABILITY_FLAKY) && first != rec->recorded) {
+        rec->flags |= STABILITY_CHANGED;
+    }
+}
+
+// Scan the claimed blocks for suspects and re-execute each of them
+static int stability_thread(SandboxContext *ctx, ScreenQueue *q)
+{
+    uint8_t  *classes  = malloc(STABILITY_BLOCK);
+    uint64_t *exec     = malloc(BITMAP_WORDS(STABILITY_BLOCK) * sizeof(uint64_t));
+    uint64_t *covered  = malloc(BITMAP_WORDS(STABILITY_BLOCK) * sizeof(uint64_t));
+    uint64_t *suspects = malloc(BITMAP_WORDS(STABILITY_BLOCK) * sizeof(uint64_t));
+    int status = 0;
+
+    if (!classes || !exec || !covered || !suspects) {
+        perror("malloc stability block failed");
+        status = -1;
+        goto out;
+    }
+
+    for (;;) {
+        int index = __atomic_fetch_add(&q->next_stability, 1, __ATOMIC_RELAXED);
+        if (index >= q->stability_count) {
+            break;
+        }
+
+        StabilityBlock *block = &q->stability[index];
+        stability_classify_block(q->prev, block->base, ctx->thumb, classes, exec, covered);
+        block->count = stability_find_suspects(classes, covered, suspects);
+        if (block->count == 0) {
+            continue;
+        }
+
+        block->records = malloc(block->count * sizeof(StabilityRecord));
+        if (!block->records) {
+            perror("malloc stability records failed");
+            block->count = 0;
+            status = -1;
+            continue;
+        }
+
+        uint32_t n = 0;
+        for (size_t i = bitmap_next_set(suspects, STABILITY_BLOCK, 0); i < STABILITY_BLOCK;
+             i = bitmap_next_set(suspects, STABILITY_BLOCK, i + 1)) {
+            StabilityRecord *rec = &block->records[n++];
+            rec->insn     = block->base + (uint32_t)i;
+            rec->recorded = classes[i];
+            stability_rerun(ctx, q, rec);
+        }
+    }
+
+out:
+    free(classes);
+    free(exec);
+    free(covered);
+    free(suspects);
+    return status;
+}
+
+/*
+ * Re-execute only what the previous run leaves open. Once a sampled
+ * stable encoding disagrees with its old outcome, the rest of the range
+ * is screened in full.
+ */
+static void screen_range_incremental(SandboxContext *ctx, OutcomeSink *sink, ScreenQueue *q)
+{
+    RangeBitmap *rb = sink->rb;
+    int (*screen_one)(SandboxContext *, uint32_t, void *) = ctx->thumb ? screen_one_t32 : screen_one_a32;
+    unsigned int seed = q->sample_seed ^ rb->start;
+    RescreenPlan plan;
+
+    if (rescreen_plan_init(&plan, q->prev, rb->start, rb->end, &seed) != 0) {
+        // Without a plan every encoding is open
+        for (uint64_t insn = rb->start; insn < rb->end; insn++) {
+            if (screen_one(ctx, (uint32_t)insn, NULL) == 0) {
+                record_ctx_outcome(sink, ctx, (uint32_t)insn);
+            }
+        }
+        return;
+    }
+
+    size_t full_from = rb->bits;           // offsets from here on all run
+    uint64_t executed = 0, sampled = 0, drifted = 0;
+    size_t off = bitmap_next_set(plan.rerun, rb->bits, 0);
+
+    while (off < rb->bits) {
+        uint32_t insn = rb->start + (uint32_t)off;
+
+        if (screen_one(ctx, insn, NULL) == 0) {
+            // Landed or state-lost counts as executed, like in the bitmap
+            int signum = (ctx->landed || ctx->state_lost) ? 0 : ctx->last_insn_signum;
+
+            record_ctx_outcome(sink, ctx, insn);
+            executed++;
+
+            if (off < full_from && bitmap_test(plan.sampled, off)) {
+                sampled++;
+                if (rescreen_outcome_changed(&plan, q->prev, insn, signum)) {
+                    drifted++;
+                    full_from = off + 1;
+                }
+            }
+        }
+
+        off = (off + 1 >= full_from) ? off + 1 : bitmap_next_set(plan.rerun, rb->bits, off + 1);
+    }
+
+    // Crashes that were not re-executed keep their previous record
+    for (uint32_t i = 0; i < plan.fault_count; i++) {
+        const FaultRecord *rec = &plan.faults[i];
+        size_t rec_off = rec->insn - rb->start;
+
+        if (rec_off < full_from && !bitmap_test(plan.rerun, rec_off) &&
+            fault_log_append(sink->log, rec) != 0) {
+            sink->log_failed = 1;
+        }
+    }
+
+    __atomic_fetch_add(&q->rescreen_executed, executed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&q->rescreen_sampled, sampled, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&q->rescreen_drifted, drifted, __ATOMIC_RELAXED);
+
+    rescreen_plan_destroy(&plan);
+}
+
+static int cmp_survey_piece(const void *a, const void *b)
+{
+    const SurveyPiece *x = a, *y = b;
+    if (x->bucket != y->bucket) return (x->bucket > y->bucket) - (x->bucket < y->bucket);
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int add_survey_piece(SurveyPiece **pieces, int *count, int *capacity, SurveyPiece piece)
+{
+    if (*count == *capacity) {
+        *capacity *= 2;
+        SurveyPiece *grown = realloc(*pieces, *capacity * sizeof(SurveyPiece));
+        if (!grown) {
+            perror("realloc survey pieces failed");
+            return -1;
+        }
+        *pieces = grown;
+    }
+    (*pieces)[(*count)++] = piece;
+    return 0;
+}
+
+/*
+ * End of the screened part of [lo, hi) that starts at lo in T32: a run
+ * of 32-bit prefixes, or the single hw1:0000 a 16-bit prefix is screened
+ * as. *next is where the next part starts.
+ */
+static uint32_t t32_screened_end(uint32_t lo, uint32_t hi, uint64_t *next)
+{
+    uint32_t hw1 = lo >> 16;
+    uint64_t prefix_end = ((uint64_t)hw1 + 1) << 16;
+
+    if (!t32_is_32bit((uint16_t)hw1)) {
+        *next = (hi < prefix_end) ? hi : prefix_end;
+        // Not screened at all unless the range holds hw1:0000
+        return ((lo & 0xffff) == 0) ? lo + 1 : lo;
+    }
+
+    while (prefix_end < hi && t32_is_32bit((uint16_t)(prefix_end >> 16))) {
+        prefix_end += 0x10000;
+    }
+    *next = (hi < prefix_end) ? hi : prefix_end;
+    return (uint32_t)*next;
+}
+
+/*
+ * Cut the file's ranges at bucket boundaries and group them into strata.
+ * In T32 the pieces hold only what a full screen executes, so a 16-bit
+ * prefix counts once in the population, not 65536 times.
+ */
+static int build_survey(ScreenQueue *q, int bucket_bits)
+{
+    int thumb = q->mode->tpl && q->mode->tpl->thumb;
+    int capacity = q->job_count;
+    int count = 0;
+    SurveyPiece *pieces = malloc(capacity * sizeof(SurveyPiece));
+    if (!pieces) {
+        perror("malloc survey pieces failed");
+        return -1;
+    }
+
+    for (int i = 0; i < q->job_count; i++) {
+        uint32_t lo = q->jobs[i].start;
+
+        while (lo < q->jobs[i].end) {
+            uint32_t bucket = bucket_bits ? lo >> (32 - bucket_bits) : 0;
+            uint64_t bucket_end = bucket_bits ? ((uint64_t)bucket + 1) << (32 - bucket_bits) : 1ull << 32;
+            uint32_t hi = (q->jobs[i].end < bucket_end) ? q->jobs[i].end : (uint32_t)bucket_end;
+            uint64_t next = hi;
+
+            uint32_t end = thumb ? t32_screened_end(lo, hi, &next) : hi;
+            if (end > lo && add_survey_piece(&pieces, &count, &capacity,
+                                             (SurveyPiece){ bucket, lo, end }) != 0) {
+                free(pieces);
+                return -1;
+            }
+            lo = (uint32_t)next;
+        }
+    }
+
+    qsort(pieces, count, sizeof(SurveyPiece), cmp_survey_piece);
+
+    // At most one stratum per piece
+    SurveyJob *survey = calloc(count ? count : 1, sizeof(SurveyJob));
+    if (!survey) {
+        perror("calloc survey strata failed");
+        free(pieces);
+        return -1;
+    }
+
+    int strata = 0;
+    for (int i = 0; i < count; i++) {
+        SurveyJob *job = strata ? &survey[strata - 1] : NULL;
+
+        if (!job || job->bucket != pieces[i].bucket) {
+            job = &survey[strata++];
+            job->bucket        = pieces[i].bucket;
+            job->first_piece   = i;
+            job->s.file_number = q->file_number;
+            job->s.start       = pieces[i].start;
+        }
+        job->piece_count++;
+        job->s.end         = pieces[i].end;
+        job->s.population += pieces[i].end - pieces[i].start;
+    }
+
+    q->survey        = survey;
+    q->survey_count  = strata;
+    q->survey_pieces = pieces;
+    return 0;
+}
+
+static void survey_one(SandboxContext *ctx, ScreenQueue *q, SurveyStratum *s, uint32_t insn)
+{
+    uint8_t insn_bytes[4];
+    size_t buf_len;
+
+    // build_survey left 16-bit T32 prefixes only their hw1:0000
+    if (ctx->thumb) {
+        buf_len = fill_t32_insn_buffer(insn_bytes, sizeof(insn_bytes), insn);
+    } else {
+        buf_len = fill_insn_buffer(insn_bytes, sizeof(insn_bytes), insn);
+    }
+
+    sandbox_ctx_execute_screen(ctx, insn_bytes, buf_len);
+
+    int signum = ctx->last_insn_signum;
+    s->sampled++;
+    if (signum == SIGALRM || signum == SIGPROF) {
+        s->timeout++;
+    } else if ((signum == 0 && !emulation_match(&q->emu, insn, ctx->thumb)) ||
+               ctx->landed || ctx->state_lost) {
+        s->exec++;
+    }
+}
+
+/*
+ * Draw survey_samples population indices with replacement (every one
+ * when the stratum is not larger), sort them and walk the pieces once.
+ */
+static int survey_stratum(SandboxContext *ctx, ScreenQueue *q, SurveyJob *job)
+{
+    SurveyStratum *s = &job->s;
+    const SurveyPiece *piece = &q->survey_pieces[job->first_piece];
+    int exhaustive = s->population <= q->survey_samples;
+    uint64_t n = exhaustive ? s->population : q->survey_samples;
+
+    uint64_t *picks = malloc(n * sizeof(uint64_t));
+    if (!picks) {
+        perror("malloc survey picks failed");
+        return -1;
+    }
+
+    uint64_t rng = survey_stream(q->survey_seed, q->file_number, job->bucket);
+    for (uint64_t i = 0; i < n; i++) {
+        picks[i] = exhaustive ? i : survey_next(&rng) % s->population;
+    }
+    if (!exhaustive) {
+        qsort(picks, n, sizeof(uint64_t), cmp_u64);
+    }
+
+    uint64_t base = 0;                     // population index of piece->start
+    for (uint64_t i = 0; i < n; i++) {
+        while (picks[i] - base >= piece->end - piece->start) {
+            base += piece->end - piece->start;
+            piece++;
+        }
+        survey_one(ctx, q, s, piece->start + (uint32_t)(picks[i] - base));
+    }
+
+    free(picks);
+    return 0;
+}
+
+static void fork_record(const FaultRecord *rec, void *arg)
+{
+    record_outcome((OutcomeSink *)arg, rec);
+}
+
+static int write_pruned_prefixes(const ScreenQueue *q)
+{
+    char pruned_filename[256];
+    snprintf(pruned_filename, sizeof(pruned_filename),
+             "%s/res%d_pruned.txt", q->output_dir, q->file_number);
+
+    FILE *f = fopen(pruned_filename, "w");
+    if (!f) {
+        fprintf(stderr, "failed to create %s\n", pruned_filename);
+        return -1;
+    }
+
+    // Same [start, end) format as the range files
+    size_t hw1;
+    bitmap_for_each_set(hw1, q->pruned_hw1, 0x10000) {
+        uint64_t end = ((uint64_t)hw1 + 1) << 16;
+        fprintf(f, "[%u, %u]\n", (uint32_t)hw1 << 16, (end > UINT32_MAX) ? UINT32_MAX : (uint32_t)end);
+    }
+
+    fclose(f);
+    return 0;
+}
+
+// Write out every finished job at the head of the queue, in input order
+static void flush_screened_jobs(ScreenQueue *q)
+{
+    pthread_mutex_lock(&q->flush_lock);
+
+    while (q->next_flush < q->job_count && q->jobs[q->next_flush].screened) {
+        RangeJob *job = &q->jobs[q->next_flush++];
+
+        if (!job->valid) {
+            continue;
+        }
+
+        if (!q->flush_failed && q->output_file) {
+            int flush_ret = range_bitmap_flush(&job->rb, q->output_file, q->timeout_file);
+            if (flush_ret < 0) {
+                fprintf(stderr, "\n[res%d] range_bitmap_flush failed for [%u, %u)\n",
+                        q->file_number, job->start, job->end);
+                q->flush_failed = 1;
+            }
+            if (flush_ret == 1) {
+                q->timeout_range_count++;
+            }
+        }
+
+        range_bitmap_destroy(&job->rb);
+        job->valid = 0;
+    }
+
+    pthread_mutex_unlock(&q->flush_lock);
+}
+
+static void *screen_thread_main(void *arg)
+{
+    ScreenThread *t = (ScreenThread *)arg;
+    ScreenQueue *q = t->queue;
+
+    if (t->core_id >= 0 && set_cpu_affinity(0, t->core_id) < 0) {
+        fprintf(stderr, "[res%d] cannot pin screening thread to core %d\n",
+                q->file_number, t->core_id);
+    }
+
+    if (q->low_jitter && set_realtime_fifo(LOWJITTER_RT_PRIORITY) < 0) {
+        fprintf(stderr, "[res%d] screening without SCHED_FIFO\n", q->file_number);
+    }
+
+    SandboxContext ctx;
+    if (sandbox_ctx_init_template(&ctx, q->mode->tpl) != 0) {
+        fprintf(stderr, "[res%d] sandbox_ctx_init failed\n", q->file_number);
+        t->status = 1;
+        return NULL;
+    }
+
+    if (q->seccomp && sandbox_ctx_seccomp(&ctx) != 0) {
+        fprintf(stderr, "[res%d] no seccomp filter, candidates make real system calls\n",
+                q->file_number);
+    }
+
+    if (q->low_jitter) {
+        if (sandbox_ctx_low_jitter(&ctx) != 0) {
+            fprintf(stderr, "[res%d] sandbox pages are not locked\n", q->file_number);
+        }
+
+        // Gaps as long as the watchdog turn into spurious timeouts
+        JitterReport jr;
+        jitter_probe(&jr, JITTER_PROBE_MS, WATCHDOG_US * 1000ull);
+        fprintf(stderr, "[res%d] core %d jitter: max %.1f us, %.1f/s over %d us, %" PRIu64
+                " over the watchdog%s\n",
+                q->file_number, sched_getcpu(), jr.max_gap_ns / 1e3,
+                jr.duration_s > 0 ? jr.gaps_over / jr.duration_s : 0.0, JITTER_GAP_NS / 1000,
+                jr.gaps_over_limit, jr.gaps_over_limit ? " (expect spurious timeouts)" : "");
+    }
+
+    if (q->stability) {
+        t->status = (stability_thread(&ctx, q) != 0);
+        sandbox_ctx_destroy(&ctx);
+        return NULL;
+    }
+
+    if (q->survey) {
+        t->status = 0;
+        for (;;) {
+            int index = __atomic_fetch_add(&q->next_survey, 1, __ATOMIC_RELAXED);
+            if (index >= q->survey_count) {
+                break;
+            }
+            if (survey_stratum(&ctx, q, &q->survey[index]) != 0) {
+                t->status = 1;
+            }
+        }
+        sandbox_ctx_destroy(&ctx);
+        return NULL;
+    }
+
+    // Heap allocated: the buffer is too large for a secondary thread's stack
+    FaultLog *log = malloc(sizeof(FaultLog));
+    if (!log) {
+        perror("malloc fault log failed");
+        sandbox_ctx_destroy(&ctx);
+        t->status = 1;
+        return NULL;
+    }
+    fault_log_init(log, &q->faults);
+
+    HitRing ring;
+    int ring_open = 0;
+    if (q->ring_dir) {
+        char ring_path[256];
+        snprintf(ring_path, sizeof(ring_path), "%s/res%d_t%d.ring",
+                 q->ring_dir, q->file_number, t->index);
+        ring_open = hit_ring_create(&ring, ring_path, HIT_RING_SLOTS_DEFAULT,
+                                    ctx.thumb, q->file_number) == 0;
+        if (!ring_open) {
+            fprintf(stderr, "[res%d] thread %d streams no hits\n", q->file_number, t->index);
+        }
+    }
+
+    // Heap allocated for the same reason as the fault log
+    RangeTrace *trace = NULL;
+    if (q->trace) {
+        trace = malloc(sizeof(RangeTrace));
+        if (!trace) {
+            perror("malloc range trace failed");
+        } else {
+            range_trace_init(trace, q->trace, t->index);
+        }
+    }
+
+    LatencyBaseline lat = { 0 };
+    OutcomeSink sink = {
+        .rb    = NULL,
+        .log   = log,
+        .gw    = NULL,
+        .emu   = &q->emu,
+        .thumb = ctx.thumb,
+        .lat   = q->time_exec ? &lat : NULL,
+        .ring  = ring_open ? &ring : NULL,
+        .trace = trace,
+    };
+    ctx.time_exec = q->time_exec;
+    GlobalMapWindow window;
+
+    ForkServer fs;
+    if (q->fork_batch &&
+        fork_server_init(&fs, &ctx, q->fork_batch,
+                         ctx.thumb ? screen_one_t32 : screen_one_a32,
+                         fork_record, &sink, q->crash_file) != 0) {
+        fprintf(stderr, "[res%d] fork_server_init failed\n", q->file_number);
+        if (ring_open) hit_ring_close(&ring);
+        if (trace) {
+            range_trace_destroy(trace);
+            free(trace);
+        }
+        free(log);
+        sandbox_ctx_destroy(&ctx);
+        t->status = 1;
+        return NULL;
+    }
+
+    t->status = 0;
+
+    for (;;) {
+        int index = __atomic_fetch_add(&q->next_job, 1, __ATOMIC_RELAXED);
+        if (index >= q->job_count || __atomic_load_n(&q->flush_failed, __ATOMIC_RELAXED)) {
+            break;
+        }
+
+        RangeJob *job = &q->jobs[index];
+        int ready;
+
+        if (q->global) {
+            // Only the bounds are used, the maps stay NULL
+            memset(&job->rb, 0, sizeof(job->rb));
+            job->rb.start = job->start;
+            job->rb.end   = job->end;
+            job->rb.bits  = job->end - job->start;
+
+            ready = global_map_window_open(&window, q->global, job->start, job->end) == 0;
+            sink.gw = ready ? &window : NULL;
+        } else {
+            ready = range_bitmap_init(&job->rb, job->start, job->end) == 0;
+        }
+
+        if (!ready) {
+            fprintf(stderr, "\n[res%d] cannot set up results for [%u, %u)\n",
+                    q->file_number, job->start, job->end);
+            t->status = 1;
+        } else {
+            job->valid = 1;
+            sink.rb = &job->rb;
+            if (trace) {
+                range_trace_begin(trace, job->start, job->end);
+            }
+            if (q->fork_batch) {
+                if (fork_server_screen(&fs, job->start, job->end) != 0) {
+                    fprintf(stderr, "\n[res%d] fork server failed for [%u, %u)\n",
+                            q->file_number, job->start, job->end);
+                    t->status = 1;
+                }
+            } else if (q->prev) {
+                screen_range_incremental(&ctx, &sink, q);
+            } else if (ctx.thumb) {
+                screen_range_t32(&ctx, &sink, q);
+            } else {
+                screen_range(&ctx, &sink);
+            }
+            if (trace && range_trace_end(trace) != 0) {
+                fprintf(stderr, "\n[res%d] writing trace records failed\n", q->file_number);
+                t->status = 1;
+            }
+            if (sink.log_failed) {
+                fprintf(stderr, "\n[res%d] writing fault records failed\n", q->file_number);
+                sink.log_failed = 0;
+                t->status = 1;
+            }
+
+            if (sink.gw) {
+                global_map_window_close(&window);
+                sink.gw = NULL;
+            }
+        }
+
+        __atomic_store_n(&job->screened, 1, __ATOMIC_RELEASE);
+        flush_screened_jobs(q);
+    }
+
+    if (fault_log_flush(log) != 0) {
+        fprintf(stderr, "\n[res%d] writing fault records failed\n", q->file_number);
+        t->status = 1;
+    }
+    free(log);
+
+    if (trace) {
+        if (range_trace_flush(trace) != 0) {
+            fprintf(stderr, "\n[res%d] writing trace records failed\n", q->file_number);
+            t->status = 1;
+        }
+        range_trace_destroy(trace);
+        free(trace);
+    }
+
+    if (ring_open) {
+        __atomic_fetch_add(&q->ring_dropped, ring.hdr->dropped, __ATOMIC_RELAXED);
+        hit_ring_close(&ring);
+    }
+
+    if (q->fork_batch) {
+        fork_server_destroy(&fs);
+    }
+    sandbox_ctx_destroy(&ctx);
+    return NULL;
+}
+
+static void close_result_files(FILE *output_file, FILE *timeout_file, GlobalMap *global)
+{
+    if (output_file)  fclose(output_file);
+    if (timeout_file) fclose(timeout_file);
+    if (global)       global_map_close(global);
+}
+
+// Runs screen_thread_main on num_threads threads (the main thread if one)
+static int run_screen_threads(ScreenQueue *q, ScreenThread *threads, int num_threads,
+                              int first_core, int low_jitter)
+{
+    int exit_code = 0;
+
+    if (num_threads == 1) {
+        // Screen on the main thread, keeping the affinity set by the dispatcher
+        threads[0].queue   = q;
+        threads[0].index   = 0;
+        threads[0].core_id = (first_core < 0 && low_jitter) ? cpu_pick_low_jitter(0) : first_core;
+        screen_thread_main(&threads[0]);
+        exit_code = threads[0].status;
+    } else {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        int started = 0;
+
+        for (int i = 0; i < num_threads; i++) {
+            threads[i].queue   = q;
+            threads[i].index   = i;
+            if (first_core >= 0) {
+                threads[i].core_id = (int)((first_core + i) % (online > 0 ? online : 1));
+            } else {
+                threads[i].core_id = low_jitter ? cpu_pick_low_jitter(i) : -1;
+            }
+            threads[i].status  = 0;
+
+            if (pthread_create(&threads[i].thread, NULL, screen_thread_main, &threads[i]) != 0) {
+                perror("pthread_create failed");
+                break;
+            }
+            started++;
+        }
+
+        for (int i = 0; i < started; i++) {
+            pthread_join(threads[i].thread, NULL);
+            if (threads[i].status != 0) {
+                exit_code = 1;
+            }
+        }
+
+        if (started == 0) {
+            exit_code = 1;
+        }
+    }
+    return exit_code;
+}
+
+static int run_survey(ScreenQueue *q, int bucket_bits, int num_threads, int first_core, int low_jitter)
+{
+    if (build_survey(q, bucket_bits) != 0) {
         return 1;
     }
 
-    int target_file_num = atoi(argv[1]);
+    ScreenThread threads[MAX_SCREEN_THREADS];
+    int exit_code = run_screen_threads(q, threads, num_threads, first_core, low_jitter);
+
+    // A thread that failed to start its sandbox leaves strata unsampled
+    if (q->next_survey < q->survey_count) {
+        exit_code = 1;
+    }
+
+    SurveyStratum *strata = malloc(q->survey_count * sizeof(SurveyStratum));
+    if (!strata) {
+        perror("malloc survey strata failed");
+        exit_code = 1;
+    } else {
+        uint64_t population = 0, sampled = 0, hits = 0;
+        double estimate = 0.0;
+
+        for (int i = 0; i < q->survey_count; i++) {
+            strata[i]   = q->survey[i].s;
+            population += strata[i].population;
+            sampled    += strata[i].sampled;
+            hits       += strata[i].exec + strata[i].timeout;
+            estimate   += survey_density(&strata[i]) * (double)strata[i].population;
+        }
+
+        char survey_filename[256];
+        snprintf(survey_filename, sizeof(survey_filename),
+                 "%s/res%d_survey.txt", q->output_dir, q->file_number);
+
+        mkdir(q->output_dir, 0755);
+        if (survey_write(survey_filename, q->file_number, q->survey_seed, bucket_bits,
+                         q->survey_samples, strata, q->survey_count) != 0) {
+            exit_code = 1;
+        }
+
+        printf("[res%d] survey: %" PRIu64 " of %" PRIu64 " encodings in %d strata, %" PRIu64
+               " hits, ~%.0f hidden\n", q->file_number, sampled, population, q->survey_count,
+               hits, estimate);
+        free(strata);
+    }
+
+    free(q->survey);
+    free(q->survey_pieces);
+    return exit_code;
+}
+
+static int cmp_stability_block(const void *a, const void *b)
+{
+    const StabilityBlock *x = a, *y = b;
+    return (x->base > y->base) - (x->base < y->base);
+}
+
+/*
+ * Stability pass over the results already in output_dir: every 2^20
+ * block the file's ranges touch, in order, so the records come out sorted.
+ */
+static int run_stability(ScreenQueue *q, int num_threads, int first_core, int low_jitter)
+{
+    PrevResults results;
+    if (prev_results_load(&results, q->output_dir, q->file_number) != 0) {
+        return 1;
+    }
+    q->prev = &results;
+
+    int capacity = q->job_count;
+    StabilityBlock *blocks = calloc(capacity, sizeof(StabilityBlock));
+    if (!blocks) {
+        perror("calloc stability blocks failed");
+        prev_results_free(&results);
+        return 1;
+    }
+
+    int count = 0;
+    for (int i = 0; i < q->job_count; i++) {
+        for (uint32_t b = q->jobs[i].start >> STABILITY_BLOCK_SHIFT;
+             b <= (q->jobs[i].end - 1) >> STABILITY_BLOCK_SHIFT; b++) {
+            uint32_t base = b << STABILITY_BLOCK_SHIFT;
+            if (count > 0 && blocks[count - 1].base == base) {
+                continue;
+            }
+            if (count == capacity) {
+                capacity *= 2;
+                StabilityBlock *grown = realloc(blocks, capacity * sizeof(StabilityBlock));
+                if (!grown) {
+                    perror("realloc stability blocks failed");
+                    free(blocks);
+                    prev_results_free(&results);
+                    return 1;
+                }
+                blocks = grown;
+            }
+            memset(&blocks[count], 0, sizeof(StabilityBlock));
+            blocks[count++].base = base;
+        }
+    }
+
+    // Input files list ranges in order, sort anyway so every block is scanned once
+    qsort(blocks, count, sizeof(StabilityBlock), cmp_stability_block);
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique == 0 || blocks[unique - 1].base != blocks[i].base) {
+            blocks[unique++] = blocks[i];
+        }
+    }
+    count = unique;
+    q->stability       = blocks;
+    q->stability_count = count;
+
+    ScreenThread threads[MAX_SCREEN_THREADS];
+    int exit_code = run_screen_threads(q, threads, num_threads, first_core, low_jitter);
+
+    if (q->next_stability < q->stability_count) {
+        exit_code = 1;
+    }
+
+    uint32_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += blocks[i].count;
+    }
+
+    StabilityRecord *records = malloc((total ? total : 1) * sizeof(StabilityRecord));
+    if (!records) {
+        perror("malloc stability records failed");
+        exit_code = 1;
+    } else {
+        uint32_t n = 0, flaky = 0, changed = 0;
+        for (int i = 0; i < count; i++) {
+            for (uint32_t j = 0; j < blocks[i].count; j++) {
+                const StabilityRecord *rec = &blocks[i].records[j];
+                flaky   += (rec->flags & STABILITY_FLAKY) != 0;
+                changed += (rec->flags & STABILITY_CHANGED) != 0;
+                records[n++] = *rec;
+            }
+        }
+
+        char stability_filename[256];
+        snprintf(stability_filename, sizeof(stability_filename),
+                 "%s/res%d_stability.bin", q->output_dir, q->file_number);
+        if (stability_write(stability_filename, q->file_number, q->stability_runs, records, n) != 0) {
+            exit_code = 1;
+        }
+
+        printf("[res%d] stability: %u suspects in %d blocks, %u flaky, %u changed over %u runs\n",
+               q->file_number, n, count, flaky, changed, q->stability_runs);
+        free(records);
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(blocks[i].records);
+    }
+    free(blocks);
+    q->stability = NULL;
+    q->prev = NULL;
+    prev_results_free(&results);
+    return exit_code;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-m a32|t32] [-P] [-j threads] [-c first_core] [-l] [-F] [-b batch]\n"
+                    "          [-p prev_dir [-r sample_every] [-u changed_ranges]] [-g global_map] [-L] [-S]\n"
+                    "          [-o output_dir] [-i input_dir] [-q ring_dir] [-y samples [-e seed] [-k bucket_bits]] [-t]\n"
+                    "          [-s runs]\n"
+                    "          <file_number>\n", prog);
+    fprintf(stderr, "Example: %s 1  # Handling results_A32/res1.txt\n", prog);
+    fprintf(stderr, "  -m  instruction set (default a32); t32 without results_T32/resN.txt\n");
+    fprintf(stderr, "      screens the whole hw1 slice N << 24\n");
+    fprintf(stderr, "  -P  t32: expand every 32-bit prefix, even if the probes all SIGILL\n");
+    fprintf(stderr, "  -j  screening threads, one sandbox context each (default 1)\n");
+    fprintf(stderr, "  -c  pin thread i to core first_core+i (default: inherit affinity)\n");
+    fprintf(stderr, "  -l  low jitter: isolcpus/nohz_full cores first (without -c), SCHED_FIFO,\n");
+    fprintf(stderr, "      locked sandbox pages, per-thread jitter self-check\n");
+    fprintf(stderr, "  -F  fork server: run each batch in a child, bisect crashed batches\n");
+    fprintf(stderr, "      (single thread, t32 prefixes are not pruned)\n");
+    fprintf(stderr, "  -b  fork server batch size (default %d)\n", FORK_DEFAULT_BATCH);
+    fprintf(stderr, "  -p  rescreen against prev_dir/resN_*.bin: only encodings that executed,\n");
+    fprintf(stderr, "      timed out, crashed unusually or were never screened run again\n");
+    fprintf(stderr, "  -r  also re-execute 1 in sample_every stable encodings (default 0)\n");
+    fprintf(stderr, "  -u  range file of encodings to re-execute regardless of prev_dir\n");
+    fprintf(stderr, "  -g  mark exec/timeout outcomes in the shared sparse map instead of\n");
+    fprintf(stderr, "      resN_complete.bin/resN_timeout.bin (created if missing, not with -p)\n");
+    fprintf(stderr, "  -L  time every execution, encodings that keep taking a trap's worth of\n");
+    fprintf(stderr, "      time are logged as emulated instead of executed (not with -F)\n");
+    fprintf(stderr, "  -o  write results here instead of bitmap_results[_T32]\n");
+    fprintf(stderr, "  -i  read resN.txt from here instead of results_A32/results_T32, e.g. the\n");
+    fprintf(stderr, "      survey_ranges/ a dispatcher survey writes (dense strata first)\n");
+    fprintf(stderr, "  -S  no seccomp filter: system calls from candidates really run\n");
+    fprintf(stderr, "  -q  stream executed and logged hits to ring_dir/resN_t<thread>.ring\n");
+    fprintf(stderr, "      (use /dev/shm) for a phase-2 hit_consumer; a full ring holds\n");
+    fprintf(stderr, "      screening back while its consumer keeps up, otherwise hits drop\n");
+    fprintf(stderr, "  -y  survey: screen only this many uniformly drawn encodings per stratum\n");
+    fprintf(stderr, "      and write resN_survey.txt with hit densities and 95%% intervals\n");
+    fprintf(stderr, "      (not with -F, -p, -g, -L, -q)\n");
+    fprintf(stderr, "  -e  survey seed (default %d), the same seed draws the same encodings\n", SURVEY_DEFAULT_SEED);
+    fprintf(stderr, "  -k  survey strata are top-bits buckets of the file, 0..%d bits (default 0:\n",
+            SURVEY_MAX_BUCKET_BITS);
+    fprintf(stderr, "      the whole file is one stratum)\n");
+    fprintf(stderr, "  -t  trace every range (wall time, thread cycles, outcomes per signal)\n");
+    fprintf(stderr, "      to resN_trace.bin, see res/phase_1/trace_to_perfetto.py (not with -F)\n");
+    fprintf(stderr, "  -s  stability pass over the results in the output directory: re-execute\n");
+    fprintf(stderr, "      encodings whose outcome disagrees with their Rm/Rd/Rt/Rn neighbors\n");
+    fprintf(stderr, "      runs times (1..255) into resN_stability.bin; -p later re-executes\n");
+    fprintf(stderr, "      the flaky ones (only with -m, -j, -c, -l, -o, -i, -S)\n");
+    fprintf(stderr, "  Encodings the kernel emulates (/proc/sys/abi) are always logged apart,\n");
+    fprintf(stderr, "  system calls from candidates as SIGSYS with the syscall number\n");
+}
+
+int main(int argc, char *argv[]) {
+
+    int num_threads = 1;
+    int first_core  = -1;
+    int prune       = 1;
+    int fork_mode   = 0;
+    int low_jitter  = 0;
+    int time_exec   = 0;
+    int seccomp     = 1;
+    int trace       = 0;
+    long stability_runs = 0;
+    long fork_batch = FORK_DEFAULT_BATCH;
+    const char *prev_dir     = NULL;
+    const char *changed_path = NULL;
+    const char *global_path  = NULL;
+    const char *output_dir   = NULL;
+    const char *input_dir    = NULL;
+    const char *ring_dir     = NULL;
+    long sample_every        = 0;
+    long survey_samples      = 0;
+    uint64_t survey_seed     = SURVEY_DEFAULT_SEED;
+    int bucket_bits          = 0;
+    const ScreenMode *mode = &screen_modes[0];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:Pj:c:lFb:p:r:u:g:LSo:i:q:y:e:k:ts:")) != -1) {
+        switch (opt) {
+        case 'm':
+            mode = NULL;
+            for (size_t i = 0; i < sizeof(screen_modes) / sizeof(screen_modes[0]); i++) {
+                if (strcmp(optarg, screen_modes[i].name) == 0) {
+                    mode = &screen_modes[i];
+                }
+            }
+            if (!mode) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'P':
+            prune = 0;
+            break;
+        case 'l':
+            low_jitter = 1;
+            break;
+        case 'F':
+            fork_mode = 1;
+            break;
+        case 'b':
+            fork_batch = atol(optarg);
+            break;
+        case 'j':
+            num_threads = atoi(optarg);
+            break;
+        case 'c':
+            first_core = atoi(optarg);
+            break;
+        case 'p':
+            prev_dir = optarg;
+            break;
+        case 'r':
+            sample_every = atol(optarg);
+            break;
+        case 'u':
+            changed_path = optarg;
+            break;
+        case 'g':
+            global_path = optarg;
+            break;
+        case 'L':
+            time_exec = 1;
+            break;
+        case 'S':
+            seccomp = 0;
+            break;
+        case 'o':
+            output_dir = optarg;
+            break;
+        case 'i':
+            input_dir = optarg;
+            break;
+        case 'q':
+            ring_dir = optarg;
+            break;
+        case 'y':
+            survey_samples = atol(optarg);
+            break;
+        case 'e':
+            survey_seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'k':
+            bucket_bits = atoi(optarg);
+            break;
+        case 't':
+            trace = 1;
+            break;
+        case 's':
+            stability_runs = atol(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc || num_threads < 1 || num_threads > MAX_SCREEN_THREADS ||
+        fork_batch < 1 || (fork_mode && num_threads != 1) ||
+        sample_every < 0 || sample_every > UINT32_MAX ||
+        (prev_dir && fork_mode) || (changed_path && !prev_dir) || (global_path && prev_dir) || (time_exec && fork_mode) ||
+        survey_samples < 0 || survey_samples > UINT32_MAX ||
+        bucket_bits < 0 || bucket_bits > SURVEY_MAX_BUCKET_BITS ||
+        (survey_samples && (fork_mode || prev_dir || global_path || time_exec || ring_dir || trace)) ||
+        (trace && fork_mode) || stability_runs < 0 || stability_runs > UINT8_MAX ||
+        (stability_runs && (fork_mode || prev_dir || global_path || time_exec || ring_dir ||
+                            trace || survey_samples))) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int target_file_num = atoi(argv[optind]);
     int file_number = target_file_num;
-    
+
     char file_num_env[32];
     snprintf(file_num_env, sizeof(file_num_env), "%d", file_number);
     setenv("RESULT_FILE_NUMBER", file_num_env, 1);
@@ -113,141 +1474,262 @@ int main(int argc, const char* argv[]) {
     init_signal_handler(signal_handler, SIGSEGV,   SA_NONE);
     init_signal_handler(signal_handler, SIGTRAP,   SA_NONE);
     init_signal_handler(signal_handler, SIGBUS,    SA_NONE);
+    init_signal_handler(signal_handler, SIGSYS,    SA_NONE);
 
     init_signal_handler(signal_handler, SIGRTMIN,  SA_NODEFER);
     init_signal_handler(signal_handler, SIGVTALRM, SA_NODEFER);
 
 
-    if (init_watchdog_timer() != 0) {
-        fprintf(stderr, "Failed to initialize watchdog timer\n");
-        return 1;
+    ScreenQueue queue;
+    memset(&queue, 0, sizeof(queue));
+    queue.file_number = file_number;
+    queue.mode        = mode;
+    if (!output_dir) {
+        output_dir = mode->output_dir;
     }
+    queue.output_dir  = output_dir;
+    queue.prune       = prune && !fork_mode;
+    queue.fork_batch  = fork_mode ? (uint32_t)fork_batch : 0;
+    queue.low_jitter  = low_jitter;
+    queue.time_exec   = time_exec;
+    queue.seccomp     = seccomp;
+    queue.ring_dir    = ring_dir;
+    queue.survey_samples = (uint32_t)survey_samples;
+    queue.survey_seed    = survey_seed;
+    queue.stability_runs = (uint32_t)stability_runs;
 
-    if (init_insn_page() != 0) {
-        perror("insn_page mmap failed");
-        timer_delete(watchdog_timer);
-        return 1;
+    char emu_names[64];
+    emulation_config_load(&queue.emu);
+    if (queue.emu.active) {
+        printf("[res%d] kernel emulates: %s\n", file_number,
+               emulation_describe(&queue.emu, emu_names, sizeof(emu_names)));
     }
 
     char input_filename[256];
-    snprintf(input_filename, sizeof(input_filename), "results_A32/res%d.txt", target_file_num);
+    snprintf(input_filename, sizeof(input_filename), "%s/res%d.txt",
+             input_dir ? input_dir : mode->input_dir, target_file_num);
+
+    uint64_t total_insns = 0;
+    int range_count;
 
     FILE *res_file = fopen(input_filename, "r");
-    if (!res_file) {
+    if (res_file) {
+        range_count = load_ranges_from_file(res_file, &queue.jobs, &total_insns);
+        fclose(res_file);
+    } else if (mode->tpl && mode->tpl->thumb &&
+               target_file_num >= 0 && target_file_num < (1 << (32 - T32_SLICE_SHIFT))) {
+        range_count = slice_ranges_t32(target_file_num, &queue.jobs, &total_insns);
+    } else {
         perror("fopen res_file");
-        munmap(insn_region, PAGE_SIZE * 3);
-        timer_delete(watchdog_timer);
         return 1;
     }
 
-    uint64_t total_insns = 0;
-    int range_count = count_ranges_in_file(res_file, &total_insns);
+    if (range_count < 0) {
+        return 1;
+    }
     if (range_count == 0) {
         printf("[res%d] invalid \n", file_number);
-        fclose(res_file);
-        munmap(insn_region, PAGE_SIZE * 3);
-        timer_delete(watchdog_timer);
+        free(queue.jobs);
         return 0;
     }
+    queue.job_count = range_count;
 
-    mkdir("bitmap_results", 0755);
-
-    char output_filename[256];
-    snprintf(output_filename, sizeof(output_filename),
-             "bitmap_results/res%d_complete.bin", file_number);
+    if (stability_runs) {
+        int exit_code = run_stability(&queue, num_threads, first_core, low_jitter);
+        free(queue.jobs);
+        return exit_code;
+    }
 
-    FILE *output_file = fopen(output_filename, "wb");
-    if (!output_file) {
-        fprintf(stderr, "failed to create %s\n", output_filename);
-        fclose(res_file);
-        munmap(insn_region, PAGE_SIZE * 3);
-        timer_delete(watchdog_timer);
-        return 1;
+    if (survey_samples) {
+        int exit_code = run_survey(&queue, bucket_bits, num_threads, first_core, low_jitter);
+        free(queue.jobs);
+        return exit_code;
     }
 
-    char timeout_filename[256];
-    snprintf(timeout_filename, sizeof(timeout_filename),
-             "bitmap_results/res%d_timeout.bin", file_number);
+    // Read the previous run before its files can be replaced below
+    PrevResults prev;
+    if (prev_dir) {
+        if (prev_results_load(&prev, prev_dir, file_number) != 0) {
+            fprintf(stderr, "[res%d] screening every encoding\n", file_number);
+        } else if (changed_path && prev_results_load_changed(&prev, changed_path) != 0) {
+            prev_results_free(&prev);
+            free(queue.jobs);
+            return 1;
+        } else {
+            prev.sample_every = (uint32_t)sample_every;
+            queue.prev        = &prev;
+            queue.prune       = 0;         // the previous run already pruned
+            queue.sample_seed = (unsigned int)time(NULL);
+        }
+    }
 
-    FILE *timeout_file = fopen(timeout_filename, "wb");
-    if (!timeout_file) {
-        fprintf(stderr, "failed to create %s\n", timeout_filename);
-        fclose(output_file);
-        fclose(res_file);
-        munmap(insn_region, PAGE_SIZE * 3);
-        timer_delete(watchdog_timer);
-        return 1;
+    if (mode->tpl && mode->tpl->thumb && !queue.prev) {
+        queue.pruned_hw1 = calloc(BITMAP_WORDS(0x10000), sizeof(uint64_t));
+        if (!queue.pruned_hw1) {
+            perror("calloc pruned_hw1 failed");
+            if (queue.prev) prev_results_free(queue.prev);
+            free(queue.jobs);
+            return 1;
+        }
     }
 
-    // complete header：[file_number][range_count]
-    fwrite(&file_number, sizeof(int), 1, output_file);
-    fwrite(&range_count, sizeof(int), 1, output_file);
+    mkdir(output_dir, 0755);
+    if (ring_dir) {
+        mkdir(ring_dir, 0755);
+    }
 
-    // timeout header：[file_number][timeout_range_count]，will be write back
+    FILE *output_file  = NULL;
+    FILE *timeout_file = NULL;
     int timeout_range_count = 0;
-    fwrite(&file_number, sizeof(int), 1, timeout_file);
-    fwrite(&timeout_range_count, sizeof(int), 1, timeout_file); // write 0 first
-
-    char line[256];
-    int  current_range_index = 0;
+    GlobalMap global;
 
-    while (fgets(line, sizeof(line), res_file) != NULL) {
-        uint32_t range_start, range_end;
-        if (sscanf(line, "[%u, %u]", &range_start, &range_end) != 2) {
-            continue;
+    if (global_path) {
+        if (global_map_open(&global, global_path) != 0) {
+            free(queue.pruned_hw1);
+            free(queue.jobs);
+            return 1;
         }
+        queue.global = &global;
+    } else {
+        char output_filename[256];
+        snprintf(output_filename, sizeof(output_filename),
+                 "%s/res%d_complete.bin", output_dir, file_number);
 
-        if (range_end <= range_start) {
-            continue;
+        output_file = fopen(output_filename, "wb");
+        if (!output_file) {
+            fprintf(stderr, "failed to create %s\n", output_filename);
+            free(queue.pruned_hw1);
+            if (queue.prev) prev_results_free(queue.prev);
+            free(queue.jobs);
+            return 1;
         }
 
-        current_range_index++;
+        char timeout_filename[256];
+        snprintf(timeout_filename, sizeof(timeout_filename),
+                 "%s/res%d_timeout.bin", output_dir, file_number);
 
-        RangeBitmap rb;
-        if (range_bitmap_init(&rb, range_start, range_end) != 0) {
-            fprintf(stderr, "\n[res%d] range_bitmap_init failed for [%u, %u)\n",
-                    file_number, range_start, range_end);
-            continue;
+        timeout_file = fopen(timeout_filename, "wb");
+        if (!timeout_file) {
+            fprintf(stderr, "failed to create %s\n", timeout_filename);
+            fclose(output_file);
+            free(queue.pruned_hw1);
+            if (queue.prev) prev_results_free(queue.prev);
+            free(queue.jobs);
+            return 1;
         }
 
-        for (uint32_t insn = range_start; insn < range_end; ++insn) {
+        // complete header：[file_number][range_count]
+        fwrite(&file_number, sizeof(int), 1, output_file);
+        fwrite(&range_count, sizeof(int), 1, output_file);
 
-            uint8_t insn_bytes[4];
-            size_t buf_len = fill_insn_buffer(insn_bytes, sizeof(insn_bytes), insn);
+        // timeout header：[file_number][timeout_range_count]，will be write back
+        fwrite(&file_number, sizeof(int), 1, timeout_file);
+        fwrite(&timeout_range_count, sizeof(int), 1, timeout_file); // write 0 first
+    }
 
-            execute_insn_page_screen(insn_bytes, buf_len);
+    if (fork_mode) {
+        char crash_filename[256];
+        snprintf(crash_filename, sizeof(crash_filename),
+                 "%s/res%d_crash.txt", output_dir, file_number);
 
-            if (last_insn_signum == SIGALRM || last_insn_signum == SIGPROF) {
-                range_bitmap_mark_timeout(&rb, insn);
-            } else if (last_insn_signum == 0) {
-                range_bitmap_mark_exec(&rb, insn);
-            } else {
-                // crash
-            }
+        queue.crash_file = fopen(crash_filename, "w");
+        if (!queue.crash_file) {
+            fprintf(stderr, "failed to create %s\n", crash_filename);
+            close_result_files(output_file, timeout_file, queue.global);
+            free(queue.pruned_hw1);
+            if (queue.prev) prev_results_free(queue.prev);
+            free(queue.jobs);
+            return 1;
         }
+    }
 
-        int flush_ret = range_bitmap_flush(&rb, output_file, timeout_file);
-        if (flush_ret < 0) {
-            fprintf(stderr, "\n[res%d] range_bitmap_flush failed for [%u, %u)\n",
-                    file_number, range_start, range_end);
-            range_bitmap_destroy(&rb);
-            break;
+    char faults_filename[256];
+    snprintf(faults_filename, sizeof(faults_filename),
+             "%s/res%d_faults.bin", output_dir, file_number);
+
+    if (fault_log_open(&queue.faults, faults_filename, file_number) != 0) {
+        if (queue.crash_file) {
+            fclose(queue.crash_file);
         }
-        if (flush_ret == 1) {
-            timeout_range_count++;
+        close_result_files(output_file, timeout_file, queue.global);
+        free(queue.pruned_hw1);
+        if (queue.prev) prev_results_free(queue.prev);
+        free(queue.jobs);
+        return 1;
+    }
+
+    // Without the trace screening goes on, it is only a diagnostic
+    RangeTraceFile trace_file;
+    char trace_filename[256];
+    if (trace) {
+        snprintf(trace_filename, sizeof(trace_filename),
+                 "%s/res%d_trace.bin", output_dir, file_number);
+        if (range_trace_open(&trace_file, trace_filename, file_number) == 0) {
+            queue.trace = &trace_file;
         }
+    }
+
+    queue.output_file  = output_file;
+    queue.timeout_file = timeout_file;
+    pthread_mutex_init(&queue.flush_lock, NULL);
 
-        range_bitmap_destroy(&rb);
+    ScreenThread threads[MAX_SCREEN_THREADS];
+    int exit_code = run_screen_threads(&queue, threads, num_threads, first_core, low_jitter);
+
+    // A thread that failed to start its sandbox may leave claimed jobs behind
+    if (queue.next_flush < queue.job_count) {
+        exit_code = 1;
     }
 
-    fseek(timeout_file, sizeof(int), SEEK_SET);
-    fwrite(&timeout_range_count, sizeof(int), 1, timeout_file);
+    if (timeout_file) {
+        timeout_range_count = queue.timeout_range_count;
+        fseek(timeout_file, sizeof(int), SEEK_SET);
+        fwrite(&timeout_range_count, sizeof(int), 1, timeout_file);
+    }
 
-    fclose(output_file);
-    fclose(timeout_file);
-    fclose(res_file);
+    close_result_files(output_file, timeout_file, queue.global);
 
-    timer_delete(watchdog_timer);
-    munmap(insn_region, PAGE_SIZE * 3);
-    return 0;
+    if (fault_log_close(&queue.faults) != 0) {
+        fprintf(stderr, "[res%d] failed to finalize %s\n", file_number, faults_filename);
+        exit_code = 1;
+    }
+
+    if (queue.crash_file) {
+        fclose(queue.crash_file);
+    }
+
+    if (queue.trace && range_trace_close(queue.trace) != 0) {
+        fprintf(stderr, "[res%d] failed to finalize %s\n", file_number, trace_filename);
+        exit_code = 1;
+    }
+
+    if (queue.pruned_hw1) {
+        if (write_pruned_prefixes(&queue) != 0) {
+            exit_code = 1;
+        }
+        free(queue.pruned_hw1);
+    }
+
+    for (int i = queue.next_flush; i < queue.job_count; i++) {
+        if (queue.jobs[i].valid) {
+            range_bitmap_destroy(&queue.jobs[i].rb);
+        }
+    }
+    if (queue.prev) {
+        printf("[res%d] rescreen: %" PRIu64 " of %" PRIu64 " encodings executed, "
+               "%" PRIu64 " samples, %" PRIu64 " changed\n", file_number,
+               queue.rescreen_executed, total_insns, queue.rescreen_sampled,
+               queue.rescreen_drifted);
+        prev_results_free(queue.prev);
+    }
+
+    if (ring_dir && queue.ring_dropped) {
+        printf("[res%d] %" PRIu64 " hits dropped, no consumer kept up\n",
+               file_number, queue.ring_dropped);
+    }
+
+    pthread_mutex_destroy(&queue.flush_lock);
+    free(queue.jobs);
+
+    return exit_code;
 }
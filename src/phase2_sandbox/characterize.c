@@ -0,0 +1,272 @@
+#include "core.h"
+#include "phase2_common.h"
+#include "encoding_list.h"
+
+/*
+ * Throughput characterization of phase-1 hits.
+ *
+ * One execution of a candidate is dwarfed by the boilerplate around it,
+ * so a one-cycle instruction looks like a microcoded one. Here each
+ * candidate that is safe to repeat is written N times in a row into the
+ * unroll_template page and timed at two unroll counts; the difference
+ * cancels the fixed entry/exit cost and leaves the per-instruction cost:
+ * user-space cycles and instructions retired from a PMU group, and wall
+ * time, which also catches instructions the kernel emulates. The NOP
+ * slope measured the same way is the baseline.
+ *
+ * A candidate is repeated only if a single run in the regs_template page
+ * executed, fell through, left SP and LR alone and wrote no memory: no
+ * stores beyond the template's own (ST_RETIRED), and the stack slots
+ * above its SP, which hold the callers' frames, unchanged.
+ */
+
+#define UNROLL_SLOTS        768            // unroll_template.S
+#define UNROLL_LO           32
+#define UNROLL_HI_DEFAULT   512
+#define RUNS_DEFAULT        9
+// Long enough for UNROLL_HI_DEFAULT kernel-emulated instructions
+#define UNROLL_WATCHDOG_US  50000
+// Words of the probe's own frame checked after each run, in reach of [sp, #imm12]
+#define STACK_CANARY_WORDS  64
+#define STACK_CANARY        0x5a17c0deu
+
+extern char unroll_boilerplate_start, unroll_boilerplate_end, unroll_insn_location;
+
+static const SandboxTemplate unroll_template = {
+    .start    = &unroll_boilerplate_start,
+    .end      = &unroll_boilerplate_end,
+    .location = &unroll_insn_location,
+    .thumb    = 0,
+};
+
+typedef struct {
+    double cycles;                         // per instruction
+    double insns;
+    double ns;
+} Slope;
+
+static uint32_t sequential_pc_delta;
+static uint32_t unroll_buf[UNROLL_SLOTS];
+static PmuCounter pmu;
+static PmuResult  baseline;
+
+/*
+ * One run in regs_template: does the candidate leave the control state
+ * and memory alone? The canary lives in this frame, above the template's
+ * SP, so an SP-relative store the counter misses still shows up.
+ */
+static int probe_repeatable(SandboxContext *ctx, uint32_t insn, int *signum)
+{
+    RegisterStates states[2];
+    PmuResult result = { 0, 0 };
+    volatile uint32_t canary[STACK_CANARY_WORDS];
+
+    for (int i = 0; i < STACK_CANARY_WORDS; i++) {
+        canary[i] = STACK_CANARY ^ (uint32_t)i;
+    }
+
+    phase2_run_pmu(ctx, states, &pmu, &result, insn);
+
+    *signum = ctx->last_insn_signum;
+    if (*signum != 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < STACK_CANARY_WORDS; i++) {
+        if (canary[i] != (STACK_CANARY ^ (uint32_t)i)) {
+            return 0;
+        }
+    }
+    if (pmu.st_retired_fd >= 0 && result.st_count > baseline.st_count) {
+        return 0;
+    }
+
+    return states[1].pc - states[0].pc == sequential_pc_delta &&
+           states[1].sp == states[0].sp &&
+           states[1].lr == states[0].lr;
+}
+
+// Best of `runs` executions of n copies, 0 on success or the signal number
+static int time_unrolled(SandboxContext *ctx, PmuGroup *g, uint32_t insn,
+                         uint32_t n, int runs, PmuGroupResult *best)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        unroll_buf[i] = insn;
+    }
+    // b unroll_exit, which sits right after the last slot
+    int32_t imm24 = (int32_t)UNROLL_SLOTS - (int32_t)(n + 2);
+    unroll_buf[n] = 0xea000000 | ((uint32_t)imm24 & 0x00ffffff);
+
+    best->cycles = best->insns = best->ns = UINT64_MAX;
+
+    for (int r = 0; r < runs; r++) {
+        PmuGroupResult res;
+        sandbox_ctx_execute_group(ctx, (uint8_t *)unroll_buf, (n + 1) * sizeof(uint32_t), g, &res);
+        if (ctx->last_insn_signum != 0) {
+            return ctx->last_insn_signum;
+        }
+
+        // Minimum per counter: interrupts only ever add
+        if (res.cycles < best->cycles) best->cycles = res.cycles;
+        if (res.insns  < best->insns)  best->insns  = res.insns;
+        if (res.ns     < best->ns)     best->ns     = res.ns;
+    }
+
+    return 0;
+}
+
+static int measure_slope(SandboxContext *ctx, PmuGroup *g, uint32_t insn,
+                         uint32_t n_hi, int runs, Slope *s)
+{
+    PmuGroupResult lo, hi;
+    int signum;
+
+    if ((signum = time_unrolled(ctx, g, insn, UNROLL_LO, runs, &lo)) != 0 ||
+        (signum = time_unrolled(ctx, g, insn, n_hi, runs, &hi)) != 0) {
+        return signum;
+    }
+
+    double span = (double)(n_hi - UNROLL_LO);
+    s->cycles = ((double)hi.cycles - (double)lo.cycles) / span;
+    s->insns  = ((double)hi.insns  - (double)lo.insns)  / span;
+    s->ns     = ((double)hi.ns     - (double)lo.ns)     / span;
+    return 0;
+}
+
+static double ratio(double a, double b)
+{
+    return b > 0 ? a / b : 0.0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-o timing.csv] [-n unroll] [-k runs] [encodings_file | -]\n", prog);
+    fprintf(stderr, "Example: %s decoded_ranges/res1_complete_decoded.txt\n", prog);
+    fprintf(stderr, "  -n  copies in the long run (default %d, %d..%d)\n",
+            UNROLL_HI_DEFAULT, UNROLL_LO + 1, UNROLL_SLOTS - 1);
+    fprintf(stderr, "  -k  runs per unroll count, the fastest counts (default %d)\n", RUNS_DEFAULT);
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = NULL;
+    long n_hi = UNROLL_HI_DEFAULT;
+    int runs = RUNS_DEFAULT;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:n:k:")) != -1) {
+        switch (opt) {
+        case 'o':
+            out_path = optarg;
+            break;
+        case 'n':
+            n_hi = atol(optarg);
+            break;
+        case 'k':
+            runs = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (n_hi <= UNROLL_LO || n_hi >= UNROLL_SLOTS || runs < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *in = stdin;
+    if (optind < argc && strcmp(argv[optind], "-") != 0) {
+        in = fopen(argv[optind], "r");
+        if (!in) {
+            fprintf(stderr, "failed to open %s\n", argv[optind]);
+            return 1;
+        }
+    }
+
+    FILE *out = stdout;
+    if (out_path) {
+        out = fopen(out_path, "w");
+        if (!out) {
+            fprintf(stderr, "failed to create %s\n", out_path);
+            return 1;
+        }
+    }
+
+    phase2_init_signal_handlers();
+
+    // Each page gets its own filter, together they cover both
+    SandboxContext reg_ctx, unroll_ctx;
+    if (phase2_ctx_init(&reg_ctx, NULL) != 0) {
+        return 1;
+    }
+    if (phase2_ctx_init(&unroll_ctx, &unroll_template) != 0) {
+        sandbox_ctx_destroy(&reg_ctx);
+        return 1;
+    }
+    unroll_ctx.watchdog_us = UNROLL_WATCHDOG_US;
+
+    PmuGroup group;
+    if (pmu_group_open(&group) != 0) {
+        fprintf(stderr, "no PMU group, only wall time is reported\n");
+    }
+
+    init_memory_monitor(&pmu);
+    if (pmu.st_retired_fd < 0) {
+        fprintf(stderr, "store counter unavailable, only the stack canary catches stores\n");
+    }
+
+    // Calibration: fall-through PC delta and the template's own stores, then the NOP slope
+    Slope nop;
+    if (phase2_calibrate(&reg_ctx, &pmu, &baseline, &sequential_pc_delta) != 0 ||
+        measure_slope(&unroll_ctx, &group, PHASE2_NOP_A32, (uint32_t)n_hi, runs, &nop) != 0) {
+        fprintf(stderr, "calibration nop raised a signal\n");
+        pmu_group_close(&group);
+        sandbox_ctx_destroy(&unroll_ctx);
+        sandbox_ctx_destroy(&reg_ctx);
+        return 1;
+    }
+    fprintf(stderr, "nop: %.3f cycles, %.3f insns, %.3f ns per instruction\n",
+            nop.cycles, nop.insns, nop.ns);
+
+    fprintf(out, "insn,outcome,repeatable,cycles_per_insn,insns_per_insn,ns_per_insn,"
+                 "cycles_vs_nop,ns_vs_nop\n");
+
+    EncodingReader reader;
+    uint32_t insn;
+    uint64_t count = 0, timed = 0;
+
+    encoding_reader_init(&reader, in);
+
+    while (encoding_reader_next(&reader, &insn)) {
+        int signum;
+        int repeatable = probe_repeatable(&reg_ctx, insn, &signum);
+        count++;
+
+        if (!repeatable) {
+            fprintf(out, "0x%08x,%s,0,,,,,\n", insn, phase2_outcome_name(signum));
+            continue;
+        }
+
+        Slope s;
+        signum = measure_slope(&unroll_ctx, &group, insn, (uint32_t)n_hi, runs, &s);
+        if (signum != 0) {
+            // Faults only once repeated, e.g. a writeback walking off a mapping
+            fprintf(out, "0x%08x,unroll_%s,0,,,,,\n", insn, phase2_outcome_name(signum));
+            continue;
+        }
+
+        fprintf(out, "0x%08x,exec,1,%.3f,%.3f,%.3f,%.3f,%.3f\n", insn,
+                s.cycles, s.insns, s.ns, ratio(s.cycles, nop.cycles), ratio(s.ns, nop.ns));
+        timed++;
+    }
+
+    fprintf(stderr, "%" PRIu64 " encodings, %" PRIu64 " timed\n", count, timed);
+
+    if (in != stdin) fclose(in);
+    if (out != stdout) fclose(out);
+    pmu_group_close(&group);
+    sandbox_ctx_destroy(&unroll_ctx);
+    sandbox_ctx_destroy(&reg_ctx);
+    return 0;
+}
@@ -0,0 +1,368 @@
+#include "core.h"
+#include "phase2_common.h"
+#include "encoding_list.h"
+
+/*
+ * Behavior-signature clustering of hidden encodings.
+ *
+ * Every encoding from the input list (see encoding_list.h) runs once in
+ * the regs_template page with the load/store PMU counters around it. Its
+ * signature is the set of registers it changed, the CPSR flags it
+ * flipped, its load/store counts and, for faulting encodings, the signal
+ * and si_code. Encodings with equal signatures land in one cluster of a
+ * hash index; each cluster is written with its representative (lowest
+ * encoding) and member list, largest clusters first.
+ */
+
+#define SIG_REG_SP       (1u << 13)
+#define SIG_REG_LR       (1u << 14)
+#define SIG_REG_PC       (1u << 15)        // did not fall through
+#define INDEX_MIN_SLOTS  1024
+
+typedef struct {
+    uint8_t  signum;                       // 0: executed
+    uint8_t  flags;                        // flipped NZCVQ, bit 4 = N
+    uint8_t  ge;                           // flipped GE[3:0]
+    uint8_t  reserved;
+    uint16_t reg_mask;                     // bit i: ri changed, plus SIG_REG_*
+    int16_t  si_code;
+    uint32_t loads;                        // beyond the template's own
+    uint32_t stores;
+} Signature;
+
+typedef struct {
+    Signature sig;
+    uint32_t  representative;
+    uint32_t *members;
+    size_t    count;
+    size_t    capacity;
+} Cluster;
+
+typedef struct {
+    Cluster  *clusters;
+    size_t    cluster_count;
+    size_t    cluster_capacity;
+
+    int32_t  *slots;                       // cluster index or -1
+    size_t    slot_count;                  // power of two
+} ClusterIndex;
+
+static PmuCounter pmu;
+static PmuResult  baseline;
+static uint32_t   sequential_pc_delta;
+
+static uint64_t signature_hash(const Signature *sig)
+{
+    // FNV-1a over the packed fields
+    const uint8_t *p = (const uint8_t *)sig;
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < sizeof(*sig); i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static int index_init(ClusterIndex *idx)
+{
+    memset(idx, 0, sizeof(*idx));
+
+    idx->slots = malloc(INDEX_MIN_SLOTS * sizeof(int32_t));
+    if (!idx->slots) {
+        perror("malloc cluster index failed");
+        return -1;
+    }
+    memset(idx->slots, 0xff, INDEX_MIN_SLOTS * sizeof(int32_t));
+    idx->slot_count = INDEX_MIN_SLOTS;
+    return 0;
+}
+
+static void index_destroy(ClusterIndex *idx)
+{
+    for (size_t i = 0; i < idx->cluster_count; i++) {
+        free(idx->clusters[i].members);
+    }
+    free(idx->clusters);
+    free(idx->slots);
+    memset(idx, 0, sizeof(*idx));
+}
+
+// Keeps the load factor at or below one half
+static int index_grow(ClusterIndex *idx)
+{
+    size_t slot_count = idx->slot_count * 2;
+    int32_t *slots = malloc(slot_count * sizeof(int32_t));
+    if (!slots) {
+        perror("malloc cluster index failed");
+        return -1;
+    }
+    memset(slots, 0xff, slot_count * sizeof(int32_t));
+
+    for (size_t c = 0; c < idx->cluster_count; c++) {
+        size_t s = signature_hash(&idx->clusters[c].sig) & (slot_count - 1);
+        while (slots[s] >= 0) {
+            s = (s + 1) & (slot_count - 1);
+        }
+        slots[s] = (int32_t)c;
+    }
+
+    free(idx->slots);
+    idx->slots      = slots;
+    idx->slot_count = slot_count;
+    return 0;
+}
+
+static int cluster_add_member(Cluster *c, uint32_t insn)
+{
+    if (c->count == c->capacity) {
+        size_t capacity = c->capacity ? c->capacity * 2 : 16;
+        uint32_t *grown = realloc(c->members, capacity * sizeof(uint32_t));
+        if (!grown) {
+            perror("realloc cluster members failed");
+            return -1;
+        }
+        c->members  = grown;
+        c->capacity = capacity;
+    }
+
+    c->members[c->count++] = insn;
+    if (insn < c->representative) {
+        c->representative = insn;
+    }
+    return 0;
+}
+
+static int index_insert(ClusterIndex *idx, const Signature *sig, uint32_t insn)
+{
+    size_t s = signature_hash(sig) & (idx->slot_count - 1);
+
+    while (idx->slots[s] >= 0) {
+        Cluster *c = &idx->clusters[idx->slots[s]];
+        if (memcmp(&c->sig, sig, sizeof(*sig)) == 0) {
+            return cluster_add_member(c, insn);
+        }
+        s = (s + 1) & (idx->slot_count - 1);
+    }
+
+    if (idx->cluster_count == idx->cluster_capacity) {
+        size_t capacity = idx->cluster_capacity ? idx->cluster_capacity * 2 : 64;
+        Cluster *grown = realloc(idx->clusters, capacity * sizeof(Cluster));
+        if (!grown) {
+            perror("realloc clusters failed");
+            return -1;
+        }
+        idx->clusters         = grown;
+        idx->cluster_capacity = capacity;
+    }
+
+    Cluster *c = &idx->clusters[idx->cluster_count];
+    memset(c, 0, sizeof(*c));
+    c->sig            = *sig;
+    c->representative = insn;
+
+    idx->slots[s] = (int32_t)idx->cluster_count++;
+
+    if (cluster_add_member(c, insn) != 0) {
+        return -1;
+    }
+    if (idx->cluster_count * 2 > idx->slot_count) {
+        return index_grow(idx);
+    }
+    return 0;
+}
+
+static void compute_signature(Signature *sig, const SandboxContext *ctx,
+                              const RegisterStates *states, const PmuResult *result)
+{
+    memset(sig, 0, sizeof(*sig));
+
+    if (ctx->last_insn_signum != 0) {
+        // No after snapshot and no meaningful counts
+        sig->signum  = (uint8_t)ctx->last_insn_signum;
+        sig->si_code = (ctx->last_insn_signum == SIGALRM) ? 0 : (int16_t)ctx->fault_code;
+        return;
+    }
+
+    const RegisterStates *b = &states[0];
+    const RegisterStates *a = &states[1];
+    const uint32_t *gb = &b->r0;
+    const uint32_t *ga = &a->r0;
+
+    for (int i = 0; i < PHASE2_GPRS; i++) {
+        if (gb[i] != ga[i]) {
+            sig->reg_mask |= 1u << i;
+        }
+    }
+    if (b->sp != a->sp) sig->reg_mask |= SIG_REG_SP;
+    if (b->lr != a->lr) sig->reg_mask |= SIG_REG_LR;
+    if (a->pc - b->pc != sequential_pc_delta) sig->reg_mask |= SIG_REG_PC;
+
+    uint32_t cpsr_delta = b->cpsr ^ a->cpsr;
+    sig->flags = (cpsr_delta >> 27) & 0x1f;
+    sig->ge    = (cpsr_delta >> 16) & 0xf;
+
+    sig->loads  = (result->ld_count > baseline.ld_count) ? (uint32_t)(result->ld_count - baseline.ld_count) : 0;
+    sig->stores = (result->st_count > baseline.st_count) ? (uint32_t)(result->st_count - baseline.st_count) : 0;
+}
+
+static void print_cluster(FILE *out, size_t id, const Cluster *c)
+{
+    const Signature *sig = &c->sig;
+
+    fprintf(out, "{\"cluster\":%zu,\"size\":%zu,\"representative\":\"0x%08x\","
+                 "\"signature\":{\"outcome\":\"%s\",\"signal\":%d,\"si_code\":%d,\"regs\":[",
+            id, c->count, c->representative, phase2_outcome_name(sig->signum), sig->signum, sig->si_code);
+
+    int first = 1;
+    for (int i = 0; i < PHASE2_GPRS; i++) {
+        if (sig->reg_mask & (1u << i)) {
+            fprintf(out, "%s\"%s\"", first ? "" : ",", phase2_reg_names[i]);
+            first = 0;
+        }
+    }
+
+    fprintf(out, "],\"sp\":%s,\"lr\":%s,\"sequential\":%s,\"flags\":\"%s%s%s%s%s\",\"ge\":\"0x%x\","
+                 "\"loads\":%u,\"stores\":%u},\"members\":[",
+            (sig->reg_mask & SIG_REG_SP) ? "true" : "false",
+            (sig->reg_mask & SIG_REG_LR) ? "true" : "false",
+            (sig->reg_mask & SIG_REG_PC) ? "false" : "true",
+            (sig->flags & 0x10) ? "N" : "", (sig->flags & 0x08) ? "Z" : "",
+            (sig->flags & 0x04) ? "C" : "", (sig->flags & 0x02) ? "V" : "",
+            (sig->flags & 0x01) ? "Q" : "",
+            sig->ge, sig->loads, sig->stores);
+
+    for (size_t i = 0; i < c->count; i++) {
+        fprintf(out, "%s\"0x%08x\"", i ? "," : "", c->members[i]);
+    }
+    fprintf(out, "]}\n");
+}
+
+static int cmp_cluster_size_desc(const void *a, const void *b)
+{
+    const Cluster *ca = (const Cluster *)a;
+    const Cluster *cb = (const Cluster *)b;
+
+    if (ca->count != cb->count) {
+        return (ca->count < cb->count) ? 1 : -1;
+    }
+    return (ca->representative > cb->representative) - (ca->representative < cb->representative);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-o clusters.jsonl] [-r representatives.txt] [encodings_file | -]\n", prog);
+    fprintf(stderr, "  -o  one JSON record per cluster, largest first (default stdout)\n");
+    fprintf(stderr, "  -r  representatives only, one encoding per line (macro_valid input)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path  = NULL;
+    const char *reps_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:r:")) != -1) {
+        switch (opt) {
+        case 'o':
+            out_path = optarg;
+            break;
+        case 'r':
+            reps_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    FILE *in = stdin;
+    if (optind < argc && strcmp(argv[optind], "-") != 0) {
+        in = fopen(argv[optind], "r");
+        if (!in) {
+            fprintf(stderr, "failed to open %s\n", argv[optind]);
+            return 1;
+        }
+    }
+
+    phase2_init_signal_handlers();
+
+    SandboxContext ctx;
+    if (phase2_ctx_init(&ctx, NULL) != 0) {
+        return 1;
+    }
+
+    init_memory_monitor(&pmu);
+    if (pmu.ld_retired_fd < 0 || pmu.st_retired_fd < 0) {
+        fprintf(stderr, "load/store counters unavailable, clustering without them\n");
+    }
+
+    // The template's own loads and stores, smallest of a few nop runs
+    if (phase2_calibrate(&ctx, &pmu, &baseline, &sequential_pc_delta) != 0) {
+        sandbox_ctx_destroy(&ctx);
+        return 1;
+    }
+
+    RegisterStates states[2];
+    PmuResult result;
+
+    ClusterIndex idx;
+    if (index_init(&idx) != 0) {
+        sandbox_ctx_destroy(&ctx);
+        return 1;
+    }
+
+    EncodingReader reader;
+    uint32_t insn;
+    uint64_t count = 0;
+    int exit_code = 0;
+
+    encoding_reader_init(&reader, in);
+
+    while (encoding_reader_next(&reader, &insn)) {
+        Signature sig;
+
+        phase2_run_pmu(&ctx, states, &pmu, &result, insn);
+        compute_signature(&sig, &ctx, states, &result);
+
+        if (index_insert(&idx, &sig, insn) != 0) {
+            exit_code = 1;
+            break;
+        }
+        count++;
+    }
+
+    if (in != stdin) fclose(in);
+    sandbox_ctx_destroy(&ctx);
+
+    // The hash slots are not needed past this point, sorting moves clusters
+    qsort(idx.clusters, idx.cluster_count, sizeof(Cluster), cmp_cluster_size_desc);
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "failed to create %s\n", out_path);
+        index_destroy(&idx);
+        return 1;
+    }
+    for (size_t i = 0; i < idx.cluster_count; i++) {
+        print_cluster(out, i, &idx.clusters[i]);
+    }
+    if (out != stdout) fclose(out);
+
+    if (reps_path) {
+        FILE *reps = fopen(reps_path, "w");
+        if (!reps) {
+            fprintf(stderr, "failed to create %s\n", reps_path);
+            exit_code = 1;
+        } else {
+            for (size_t i = 0; i < idx.cluster_count; i++) {
+                fprintf(reps, "0x%08x\n", idx.clusters[i].representative);
+            }
+            fclose(reps);
+        }
+    }
+
+    fprintf(stderr, "%" PRIu64 " encodings in %zu clusters\n", count, idx.cluster_count);
+
+    index_destroy(&idx);
+    return exit_code;
+}
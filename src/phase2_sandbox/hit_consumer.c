@@ -0,0 +1,186 @@
+#include "core.h"
+#include "phase2_common.h"
+#include "cpu_affinity.h"
+#include "hit_ring.h"
+
+/*
+ * Phase-2 consumer of one worker thread's hit ring (worker -q).
+ *
+ * Every A32 hit is run again in the regs_template page with the
+ * load/store PMU counters around it, as cluster_behavior does, and
+ * written as one JSON line the moment it is popped: the phase-1
+ * outcome, the phase-2 outcome, the registers it changed (before and
+ * after), flipped flags and the loads/stores beyond a nop's. Rings of a
+ * T32 worker are only copied out, the template is A32.
+ */
+
+#define ATTACH_WAIT_MS   60000
+
+static PmuCounter pmu;
+static PmuResult  baseline;
+static uint32_t   sequential_pc_delta;
+
+static void print_hit(FILE *out, const HitRingHeader *h, const FaultRecord *rec, const SandboxContext *ctx,
+                      const RegisterStates *states, const PmuResult *result)
+{
+    fprintf(out, "{\"insn\":\"0x%08x\",\"file\":%d,\"phase1\":{\"outcome\":\"%s\",\"signal\":%d,"
+                 "\"landed\":%s,\"state_lost\":%s}",
+            rec->insn, h->file_number, phase2_outcome_name(rec->signum), rec->signum,
+            (rec->flags & FAULT_FLAG_LANDED) ? "true" : "false",
+            (rec->flags & FAULT_FLAG_STATE_LOST) ? "true" : "false");
+
+    if (!ctx) {
+        fprintf(out, "}\n");
+        return;
+    }
+
+    int signum = ctx->last_insn_signum;
+    fprintf(out, ",\"phase2\":{\"outcome\":\"%s\",\"signal\":%d", phase2_outcome_name(signum), signum);
+
+    if (signum != 0) {
+        // No after snapshot and no meaningful counts
+        fprintf(out, ",\"si_code\":%d}}\n", (signum == SIGALRM) ? 0 : ctx->fault_code);
+        return;
+    }
+
+    const RegisterStates *b = &states[0];
+    const RegisterStates *a = &states[1];
+    const uint32_t *gb = &b->r0;
+    const uint32_t *ga = &a->r0;
+
+    fprintf(out, ",\"regs\":{");
+    int first = 1;
+    for (int i = 0; i < PHASE2_GPRS; i++) {
+        if (gb[i] != ga[i]) {
+            fprintf(out, "%s\"%s\":[\"0x%08x\",\"0x%08x\"]", first ? "" : ",", phase2_reg_names[i], gb[i], ga[i]);
+            first = 0;
+        }
+    }
+    if (b->sp != a->sp) {
+        fprintf(out, "%s\"sp\":[\"0x%08x\",\"0x%08x\"]", first ? "" : ",", b->sp, a->sp);
+        first = 0;
+    }
+    if (b->lr != a->lr) {
+        fprintf(out, "%s\"lr\":[\"0x%08x\",\"0x%08x\"]", first ? "" : ",", b->lr, a->lr);
+    }
+
+    uint32_t cpsr_delta = b->cpsr ^ a->cpsr;
+    uint64_t loads  = (result->ld_count > baseline.ld_count) ? result->ld_count - baseline.ld_count : 0;
+    uint64_t stores = (result->st_count > baseline.st_count) ? result->st_count - baseline.st_count : 0;
+
+    fprintf(out, "},\"sequential\":%s,\"flags\":\"%s%s%s%s%s\",\"ge\":\"0x%x\","
+                 "\"loads\":%" PRIu64 ",\"stores\":%" PRIu64 "}}\n",
+            (a->pc - b->pc == sequential_pc_delta) ? "true" : "false",
+            (cpsr_delta & (1u << 31)) ? "N" : "", (cpsr_delta & (1u << 30)) ? "Z" : "",
+            (cpsr_delta & (1u << 29)) ? "C" : "", (cpsr_delta & (1u << 28)) ? "V" : "",
+            (cpsr_delta & (1u << 27)) ? "Q" : "",
+            (cpsr_delta >> 16) & 0xf, loads, stores);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-c core] [-o hits.jsonl] <ring_file>\n", prog);
+    fprintf(stderr, "Example: %s -c 3 -o hits_res1_t0.jsonl /dev/shm/rings/res1_t0.ring\n", prog);
+    fprintf(stderr, "  -c  pin to this core, away from the screening threads\n");
+    fprintf(stderr, "  -o  one JSON record per hit (default stdout)\n");
+    fprintf(stderr, "  Waits up to %d s for the ring, exits once the worker is done and\n", ATTACH_WAIT_MS / 1000);
+    fprintf(stderr, "  the ring is drained\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = NULL;
+    int core_id = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:o:")) != -1) {
+        switch (opt) {
+        case 'c':
+            core_id = atoi(optarg);
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (core_id >= 0 && set_cpu_affinity(0, core_id) < 0) {
+        fprintf(stderr, "cannot pin to core %d\n", core_id);
+    }
+
+    HitRing ring;
+    if (hit_ring_attach(&ring, argv[optind], ATTACH_WAIT_MS) != 0) {
+        return 1;
+    }
+    int thumb = ring.hdr->thumb != 0;
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "failed to create %s\n", out_path);
+        hit_ring_close(&ring);
+        return 1;
+    }
+
+    phase2_init_signal_handlers();
+
+    SandboxContext ctx;
+    RegisterStates states[2];
+    PmuResult result;
+
+    if (!thumb) {
+        if (phase2_ctx_init(&ctx, NULL) != 0) {
+            hit_ring_close(&ring);
+            return 1;
+        }
+
+        init_memory_monitor(&pmu);
+        if (pmu.ld_retired_fd < 0 || pmu.st_retired_fd < 0) {
+            fprintf(stderr, "load/store counters unavailable, reporting registers only\n");
+        }
+
+        if (phase2_calibrate(&ctx, &pmu, &baseline, &sequential_pc_delta) != 0) {
+            sandbox_ctx_destroy(&ctx);
+            hit_ring_close(&ring);
+            return 1;
+        }
+    } else {
+        fprintf(stderr, "T32 ring, hits are copied without running them\n");
+    }
+
+    FaultRecord rec;
+    uint64_t count = 0;
+    int status;
+
+    while ((status = hit_ring_pop(&ring, &rec)) >= 0) {
+        if (status == 0) {
+            // Caught up: let whoever tails the output see it
+            fflush(out);
+            struct timespec nap = { 0, HIT_RING_WAIT_NS };
+            nanosleep(&nap, NULL);
+            continue;
+        }
+
+        if (thumb) {
+            print_hit(out, ring.hdr, &rec, NULL, NULL, NULL);
+        } else {
+            phase2_run_pmu(&ctx, states, &pmu, &result, rec.insn);
+            print_hit(out, ring.hdr, &rec, &ctx, states, &result);
+        }
+        count++;
+    }
+
+    fprintf(stderr, "%" PRIu64 " hits, %" PRIu64 " dropped by the worker\n",
+            count, ring.hdr->dropped);
+
+    if (out != stdout) fclose(out);
+    if (!thumb) sandbox_ctx_destroy(&ctx);
+    hit_ring_close(&ring);
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include "core.h"
+#include "phase2_common.h"
+#include "encoding_list.h"
+
+/*
+ * Full EL0 state diff of phase-2 candidates.
+ *
+ * Like macro_valid, but every encoding runs in the regs_ext_template page,
+ * which snapshots r0-r12, SP, LR, PC, CPSR (flags and GE), FPSCR,
+ * TPIDRURW, TPIDRURO and d0-d31 around it in one execution. Each JSON
+ * record lists only what changed: registers, named CPSR/FPSCR bits, and
+ * the individual 32-bit lanes of the d registers ("d5[1]").
+ */
+
+_Static_assert(offsetof(ExtRegisterStates, fpscr)    == 68,  "regs_ext_template ST_FPSCR");
+_Static_assert(offsetof(ExtRegisterStates, tpidrurw) == 72,  "regs_ext_template ST_TPIDRURW");
+_Static_assert(offsetof(ExtRegisterStates, tpidruro) == 76,  "regs_ext_template ST_TPIDRURO");
+_Static_assert(offsetof(ExtRegisterStates, d)        == 80,  "regs_ext_template ST_D");
+_Static_assert(sizeof(ExtRegisterStates)             == 336, "regs_ext_template ST_SIZE");
+
+typedef struct {
+    uint32_t    mask;
+    const char *name;
+} NamedBits;
+
+static const NamedBits cpsr_bits[] = {
+    { 0x80000000, "N" }, { 0x40000000, "Z" }, { 0x20000000, "C" },
+    { 0x10000000, "V" }, { 0x08000000, "Q" }, { 0x000f0000, "GE" },
+};
+
+static const NamedBits fpscr_bits[] = {
+    { 0x80000000, "N" },   { 0x40000000, "Z" },   { 0x20000000, "C" },
+    { 0x10000000, "V" },   { 0x08000000, "QC" },  { 0x04000000, "AHP" },
+    { 0x02000000, "DN" },  { 0x01000000, "FZ" },  { 0x00c00000, "RMode" },
+    { 0x00370000, "Len/Stride" },
+    { 0x00000080, "IDC" }, { 0x00000010, "IXC" }, { 0x00000008, "UFC" },
+    { 0x00000004, "OFC" }, { 0x00000002, "DZC" }, { 0x00000001, "IOC" },
+};
+
+// PC distance between the two snapshots when the candidate falls through
+static uint32_t sequential_pc_delta;
+
+static void print_bits(FILE *out, const char *key, uint32_t before, uint32_t after,
+                       const NamedBits *bits, size_t n)
+{
+    uint32_t diff = before ^ after;
+
+    fprintf(out, ",\"%s\":[\"0x%08x\",\"0x%08x\"],\"%s_bits\":[", key, before, after, key);
+    int first = 1;
+    for (size_t i = 0; i < n; i++) {
+        if (diff & bits[i].mask) {
+            fprintf(out, "%s\"%s\"", first ? "" : ",", bits[i].name);
+            first = 0;
+        }
+    }
+    fprintf(out, "]");
+}
+
+static void print_pair(FILE *out, int *first, const char *name, uint32_t before, uint32_t after)
+{
+    fprintf(out, "%s\"%s\":[\"0x%08x\",\"0x%08x\"]", *first ? "" : ",", name, before, after);
+    *first = 0;
+}
+
+static void print_record(FILE *out, const SandboxContext *ctx,
+                         const ExtRegisterStates *states, uint32_t insn)
+{
+    int signum = ctx->last_insn_signum;
+
+    fprintf(out, "{\"insn\":\"0x%08x\",\"outcome\":\"%s\",\"signal\":%d",
+            insn, phase2_outcome_name(signum), signum);
+
+    if (signum != 0) {
+        // The after snapshot was never taken
+        if (signum != SIGALRM) {
+            fprintf(out, ",\"si_code\":%d,\"fault_addr\":\"0x%08x\"",
+                    ctx->fault_code, ctx->fault_addr);
+        }
+        if (ctx->landed) {
+            // Branch target, relative to the candidate
+            uint32_t location = (uint32_t)(uintptr_t)ctx->insn_page + ctx->insn_offset * 4;
+            fprintf(out, ",\"landed\":%d", (int32_t)(ctx->fault_pc - location));
+        }
+        fprintf(out, "}\n");
+        return;
+    }
+
+    const ExtRegisterStates *b = &states[0];
+    const ExtRegisterStates *a = &states[1];
+    const uint32_t *gb = &b->core.r0;
+    const uint32_t *ga = &a->core.r0;
+    char name[16];
+    int first = 1;
+
+    fprintf(out, ",\"changed\":{");
+    for (int i = 0; i < PHASE2_GPRS; i++) {
+        if (gb[i] != ga[i]) {
+            print_pair(out, &first, phase2_reg_names[i], gb[i], ga[i]);
+        }
+    }
+    if (b->core.sp != a->core.sp) print_pair(out, &first, "sp", b->core.sp, a->core.sp);
+    if (b->core.lr != a->core.lr) print_pair(out, &first, "lr", b->core.lr, a->core.lr);
+    if (a->core.pc - b->core.pc != sequential_pc_delta) {
+        print_pair(out, &first, "pc", b->core.pc, a->core.pc);
+    }
+    if (b->tpidrurw != a->tpidrurw) print_pair(out, &first, "tpidrurw", b->tpidrurw, a->tpidrurw);
+    if (b->tpidruro != a->tpidruro) print_pair(out, &first, "tpidruro", b->tpidruro, a->tpidruro);
+
+    for (int i = 0; i < 32; i++) {
+        if (b->d[i] == a->d[i]) {
+            continue;
+        }
+        for (int lane = 0; lane < 2; lane++) {
+            uint32_t lb = (uint32_t)(b->d[i] >> (32 * lane));
+            uint32_t la = (uint32_t)(a->d[i] >> (32 * lane));
+            if (lb != la) {
+                snprintf(name, sizeof(name), "d%d[%d]", i, lane);
+                print_pair(out, &first, name, lb, la);
+            }
+        }
+    }
+    fprintf(out, "}");
+
+    if (b->core.cpsr != a->core.cpsr) {
+        print_bits(out, "cpsr", b->core.cpsr, a->core.cpsr,
+                   cpsr_bits, sizeof(cpsr_bits) / sizeof(cpsr_bits[0]));
+    }
+    if (b->fpscr != a->fpscr) {
+        print_bits(out, "fpscr", b->fpscr, a->fpscr,
+                   fpscr_bits, sizeof(fpscr_bits) / sizeof(fpscr_bits[0]));
+    }
+
+    fprintf(out, ",\"sequential\":%s}\n",
+            (a->core.pc - b->core.pc == sequential_pc_delta) ? "true" : "false");
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-o output.jsonl] [encodings_file | -]\n", prog);
+    fprintf(stderr, "Example: echo 0xf2000d40 | %s\n", prog);
+    fprintf(stderr, "  one JSON record per encoding with only the changed EL0 state,\n");
+    fprintf(stderr, "  ranges \"[start, end]\" are expanded (at most %u encodings each)\n",
+            ENCODING_MAX_RANGE);
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:")) != -1) {
+        switch (opt) {
+        case 'o':
+            out_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    FILE *in = stdin;
+    if (optind < argc && strcmp(argv[optind], "-") != 0) {
+        in = fopen(argv[optind], "r");
+        if (!in) {
+            fprintf(stderr, "failed to open %s\n", argv[optind]);
+            return 1;
+        }
+    }
+
+    FILE *out = stdout;
+    if (out_path) {
+        out = fopen(out_path, "w");
+        if (!out) {
+            fprintf(stderr, "failed to create %s\n", out_path);
+            return 1;
+        }
+    }
+
+    phase2_init_signal_handlers();
+
+    SandboxContext ctx;
+    if (phase2_ctx_init(&ctx, NULL) != 0) {
+        return 1;
+    }
+    if (phase2_calibrate_ext(&ctx, &sequential_pc_delta) != 0) {
+        sandbox_ctx_destroy(&ctx);
+        return 1;
+    }
+
+    ExtRegisterStates states[2];
+
+    EncodingReader reader;
+    uint32_t insn;
+    uint64_t count = 0;
+    struct timespec t0, t1;
+
+    encoding_reader_init(&reader, in);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    while (encoding_reader_next(&reader, &insn)) {
+        phase2_run_ext(&ctx, states, insn);
+        print_record(out, &ctx, states, insn);
+        count++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    fprintf(stderr, "%" PRIu64 " encodings in %.3f s (%.1f us/encoding)\n",
+            count, elapsed, count ? elapsed * 1e6 / count : 0.0);
+
+    if (in != stdin) fclose(in);
+    if (out != stdout) fclose(out);
+    sandbox_ctx_destroy(&ctx);
+    return 0;
+}
@@ -0,0 +1,489 @@
+#include "bitmap.h"
+#include <inttypes.h>
+
+/*
+ * Range set algebra over the A32 encoding space.
+ *
+ * Inputs are range files ("[start, end]" per line, end exclusive, decimal
+ * or 0x-hex) or worker bitmap files (*.bin). A bitmap file contributes the
+ * ranges it covers, or only its set bits when named as "file.bin:bits".
+ * Every set is sorted and coalesced, so adjacent ranges such as
+ * [2097328, 2097344] [2097344, 2097360] become one.
+ */
+
+#define DEFAULT_RANGE_COST 64   // per-range overhead in encodings (alloc, header, flush)
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;               // exclusive, at most 2^32
+} Range;
+
+typedef struct {
+    Range  *r;
+    size_t  count;
+    size_t  capacity;
+} RangeSet;
+
+static int rs_push(RangeSet *rs, uint64_t start, uint64_t end)
+{
+    if (end <= start) {
+        return 0;
+    }
+
+    if (rs->count == rs->capacity) {
+        size_t capacity = rs->capacity ? rs->capacity * 2 : 4096;
+        Range *grown = realloc(rs->r, capacity * sizeof(Range));
+        if (!grown) {
+            perror("realloc ranges failed");
+            return -1;
+        }
+        rs->r = grown;
+        rs->capacity = capacity;
+    }
+
+    rs->r[rs->count].start = start;
+    rs->r[rs->count].end   = end;
+    rs->count++;
+    return 0;
+}
+
+static void rs_free(RangeSet *rs)
+{
+    free(rs->r);
+    memset(rs, 0, sizeof(*rs));
+}
+
+static int range_cmp(const void *a, const void *b)
+{
+    const Range *x = a, *y = b;
+    if (x->start != y->start) return (x->start < y->start) ? -1 : 1;
+    if (x->end   != y->end)   return (x->end   < y->end)   ? -1 : 1;
+    return 0;
+}
+
+// Sort and merge overlapping or adjacent ranges in place
+static void rs_coalesce(RangeSet *rs)
+{
+    if (rs->count == 0) {
+        return;
+    }
+
+    qsort(rs->r, rs->count, sizeof(Range), range_cmp);
+
+    size_t out = 0;
+    for (size_t i = 1; i < rs->count; i++) {
+        if (rs->r[i].start <= rs->r[out].end) {
+            if (rs->r[i].end > rs->r[out].end) {
+                rs->r[out].end = rs->r[i].end;
+            }
+        } else {
+            rs->r[++out] = rs->r[i];
+        }
+    }
+    rs->count = out + 1;
+}
+
+static uint64_t rs_size(const RangeSet *rs)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < rs->count; i++) {
+        total += rs->r[i].end - rs->r[i].start;
+    }
+    return total;
+}
+
+static int parse_number(const char **p, uint64_t *out)
+{
+    char *end;
+    while (**p == ' ' || **p == '\t' || **p == '[' || **p == ',') {
+        (*p)++;
+    }
+
+    errno = 0;
+    unsigned long long v = strtoull(*p, &end, 0);
+    if (end == *p || errno != 0 || v > (1ull << 32)) {
+        return -1;
+    }
+
+    *p = end;
+    *out = v;
+    return 0;
+}
+
+static int load_text(RangeSet *rs, FILE *f)
+{
+    char line[256];
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        const char *p = line;
+        uint64_t start, end;
+
+        if (line[0] != '[') {
+            continue;
+        }
+        if (parse_number(&p, &start) != 0 || parse_number(&p, &end) != 0) {
+            continue;
+        }
+        if (rs_push(rs, start, end) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// [file_number][range_count] then per range [start][end][size][bitmap]
+static int load_bitmap(RangeSet *rs, FILE *f, const char *path, int bits_only)
+{
+    int32_t header[2];
+    if (fread(header, sizeof(int32_t), 2, f) != 2) {
+        fprintf(stderr, "%s: header too short\n", path);
+        return -1;
+    }
+
+    uint64_t *bitmap = NULL;
+    size_t bitmap_cap = 0;                 // in words
+
+    for (int32_t i = 0; i < header[1]; i++) {
+        uint32_t rec[3];
+        if (fread(rec, sizeof(uint32_t), 3, f) != 3) {
+            fprintf(stderr, "%s: range %d header too short\n", path, i);
+            free(bitmap);
+            return -1;
+        }
+
+        uint32_t start = rec[0], end = rec[1], size = rec[2];
+
+        if (!bits_only) {
+            if (fseek(f, size, SEEK_CUR) != 0 || rs_push(rs, start, end) != 0) {
+                free(bitmap);
+                return -1;
+            }
+            continue;
+        }
+
+        uint32_t bits = end - start;
+        size_t words = BITMAP_WORDS(bits);
+
+        if (end <= start || size != (bits + 7u) / 8u) {
+            fprintf(stderr, "%s: range %d has a bad bitmap size\n", path, i);
+            free(bitmap);
+            return -1;
+        }
+
+        if (words > bitmap_cap) {
+            uint64_t *grown = realloc(bitmap, words * sizeof(uint64_t));
+            if (!grown) {
+                perror("realloc bitmap failed");
+                free(bitmap);
+                return -1;
+            }
+            bitmap = grown;
+            bitmap_cap = words;
+        }
+
+        // The file holds whole bytes only, keep the tail of the last word clear
+        bitmap[words - 1] = 0;
+        if (fread(bitmap, 1, size, f) != size) {
+            fprintf(stderr, "%s: range %d bitmap too short\n", path, i);
+            free(bitmap);
+            return -1;
+        }
+
+        size_t run_start = bitmap_next_set(bitmap, bits, 0);
+
+        while (run_start < bits) {
+            size_t run_end = bitmap_next_clear(bitmap, bits, run_start);
+            if (rs_push(rs, (uint64_t)start + run_start, (uint64_t)start + run_end) != 0) {
+                free(bitmap);
+                return -1;
+            }
+            run_start = bitmap_next_set(bitmap, bits, run_end);
+        }
+    }
+
+    free(bitmap);
+    return 0;
+}
+
+static int rs_load(RangeSet *rs, const char *arg)
+{
+    char path[4096];
+    int bits_only = 0;
+
+    snprintf(path, sizeof(path), "%s", arg);
+    size_t len = strlen(path);
+    if (len > 5 && strcmp(path + len - 5, ":bits") == 0) {
+        path[len - 5] = '\0';
+        bits_only = 1;
+        len -= 5;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    int is_bin = (len > 4 && strcmp(path + len - 4, ".bin") == 0);
+    int ret = is_bin ? load_bitmap(rs, f, path, bits_only) : load_text(rs, f);
+
+    fclose(f);
+    return ret;
+}
+
+static int rs_intersect(RangeSet *out, const RangeSet *a, const RangeSet *b)
+{
+    size_t i = 0, j = 0;
+
+    while (i < a->count && j < b->count) {
+        uint64_t lo = a->r[i].start > b->r[j].start ? a->r[i].start : b->r[j].start;
+        uint64_t hi = a->r[i].end   < b->r[j].end   ? a->r[i].end   : b->r[j].end;
+
+        if (lo < hi && rs_push(out, lo, hi) != 0) {
+            return -1;
+        }
+
+        if (a->r[i].end < b->r[j].end) i++;
+        else j++;
+    }
+    return 0;
+}
+
+static int rs_subtract(RangeSet *out, const RangeSet *a, const RangeSet *b)
+{
+    size_t j = 0;
+
+    for (size_t i = 0; i < a->count; i++) {
+        uint64_t cur = a->r[i].start;
+        uint64_t end = a->r[i].end;
+
+        while (j < b->count && b->r[j].end <= cur) {
+            j++;
+        }
+
+        for (size_t k = j; k < b->count && b->r[k].start < end; k++) {
+            if (b->r[k].start > cur && rs_push(out, cur, b->r[k].start) != 0) {
+                return -1;
+            }
+            if (b->r[k].end > cur) {
+                cur = b->r[k].end;
+            }
+            if (cur >= end) {
+                break;
+            }
+        }
+
+        if (cur < end && rs_push(out, cur, end) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int rs_write(const RangeSet *rs, FILE *out)
+{
+    for (size_t i = 0; i < rs->count; i++) {
+        // The worker reads 32-bit bounds, 2^32 itself is not representable
+        uint64_t end = rs->r[i].end > UINT32_MAX ? UINT32_MAX : rs->r[i].end;
+        if (end <= rs->r[i].start) {
+            continue;
+        }
+        if (fprintf(out, "[%" PRIu64 ", %" PRIu64 "]\n", rs->r[i].start, end) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int rs_write_path(const RangeSet *rs, const char *path)
+{
+    if (!path) {
+        return rs_write(rs, stdout);
+    }
+
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "cannot create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    int ret = rs_write(rs, f);
+    if (fclose(f) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+/*
+ * Split the set into n shards of roughly equal cost, where a range costs
+ * its encoding count plus a fixed per-range overhead. Ranges are split at
+ * shard boundaries, so a single huge range is spread over several shards.
+ */
+static int rs_shard(const RangeSet *rs, int n, uint64_t range_cost, const char *prefix)
+{
+    uint64_t total = rs_size(rs) + (uint64_t)rs->count * range_cost;
+    uint64_t target = (total + (uint64_t)n - 1) / (uint64_t)n;
+    size_t i = 0;
+    uint64_t cur = rs->count ? rs->r[0].start : 0;
+
+    for (int shard = 0; shard < n; shard++) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s%d.txt", prefix, shard);
+
+        RangeSet part = {0};
+        uint64_t budget = target;
+
+        while (i < rs->count && (budget > range_cost || shard == n - 1)) {
+            uint64_t room = (budget > range_cost) ? budget - range_cost : 0;
+            uint64_t take = rs->r[i].end - cur;
+
+            if (shard != n - 1 && take > room) {
+                take = room;
+            }
+            if (take == 0) {
+                break;
+            }
+
+            if (rs_push(&part, cur, cur + take) != 0) {
+                rs_free(&part);
+                return -1;
+            }
+            budget = (budget > take + range_cost) ? budget - take - range_cost : 0;
+            cur += take;
+
+            if (cur >= rs->r[i].end) {
+                i++;
+                if (i < rs->count) {
+                    cur = rs->r[i].start;
+                }
+            }
+        }
+
+        int ret = rs_write_path(&part, path);
+        printf("%s: %zu ranges, %" PRIu64 " encodings\n", path, part.count, rs_size(&part));
+        rs_free(&part);
+        if (ret != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s <command> [options] <set>...\n"
+        "  merge     [-o out] <set>...          coalesce (union of all inputs)\n"
+        "  union     [-o out] <set>...          same as merge\n"
+        "  intersect [-o out] <a> <b>...        encodings present in every set\n"
+        "  subtract  [-o out] <a> <b>...        a minus all following sets\n"
+        "  shard     -n N [-c cost] [-p prefix] <set>...\n"
+        "                                       N cost-balanced files prefixK.txt\n"
+        "  stats     <set>...                   range and encoding counts\n"
+        "A set is a range file, a bitmap file (covered ranges) or file.bin:bits\n"
+        "(set bits only). Per-range cost defaults to %d encodings.\n",
+        prog, DEFAULT_RANGE_COST);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char *cmd = argv[1];
+    const char *out_path = NULL;
+    const char *prefix = "shard";
+    uint64_t range_cost = DEFAULT_RANGE_COST;
+    int shards = 0;
+
+    int argi = 2;
+    while (argi < argc && argv[argi][0] == '-' && argv[argi][1] != '\0') {
+        if (argi + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        switch (argv[argi][1]) {
+        case 'o': out_path   = argv[argi + 1]; break;
+        case 'p': prefix     = argv[argi + 1]; break;
+        case 'n': shards     = atoi(argv[argi + 1]); break;
+        case 'c': range_cost = strtoull(argv[argi + 1], NULL, 0); break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+        argi += 2;
+    }
+
+    int nsets = argc - argi;
+    if (nsets < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int binary = (strcmp(cmd, "intersect") == 0 || strcmp(cmd, "subtract") == 0);
+    if (binary && nsets < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    RangeSet acc = {0};
+    int ret = 0;
+
+    if (binary) {
+        if (rs_load(&acc, argv[argi]) != 0) {
+            return 1;
+        }
+        rs_coalesce(&acc);
+
+        for (int k = argi + 1; k < argc && ret == 0; k++) {
+            RangeSet other = {0}, result = {0};
+
+            if (rs_load(&other, argv[k]) != 0) {
+                rs_free(&other);
+                ret = 1;
+                break;
+            }
+            rs_coalesce(&other);
+
+            if (cmd[0] == 'i') {
+                ret = rs_intersect(&result, &acc, &other) ? 1 : 0;
+            } else {
+                ret = rs_subtract(&result, &acc, &other) ? 1 : 0;
+            }
+
+            rs_free(&other);
+            rs_free(&acc);
+            acc = result;
+        }
+    } else {
+        for (int k = argi; k < argc; k++) {
+            if (rs_load(&acc, argv[k]) != 0) {
+                rs_free(&acc);
+                return 1;
+            }
+        }
+        rs_coalesce(&acc);
+    }
+
+    if (ret == 0) {
+        if (strcmp(cmd, "merge") == 0 || strcmp(cmd, "union") == 0 || binary) {
+            ret = rs_write_path(&acc, out_path) ? 1 : 0;
+        } else if (strcmp(cmd, "shard") == 0) {
+            if (shards < 1) {
+                usage(argv[0]);
+                ret = 1;
+            } else {
+                ret = rs_shard(&acc, shards, range_cost, prefix) ? 1 : 0;
+            }
+        } else if (strcmp(cmd, "stats") == 0) {
+            printf("ranges: %zu\nencodings: %" PRIu64 "\n", acc.count, rs_size(&acc));
+        } else {
+            usage(argv[0]);
+            ret = 1;
+        }
+    }
+
+    rs_free(&acc);
+    return ret;
+}